@@ -0,0 +1,135 @@
+#ifndef INCLUDE_EDVS_EVENTBATCHSOA_HPP
+#define INCLUDE_EDVS_EVENTBATCHSOA_HPP
+
+#include "Event.hpp"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+namespace Edvs
+{
+
+	/** Events stored as one array per field (structure of arrays)
+	 * Loops which only need timestamps (binary searches, time statistics) read
+	 * 8 instead of 16 bytes per event and loops over coordinates can be
+	 * vectorized by the compiler.
+	 * Events are expected to be ordered by timestamp for the search functions.
+	 */
+	class EventBatchSoA
+	{
+	public:
+		std::vector<uint64_t> t;
+		std::vector<uint16_t> x, y;
+		std::vector<uint8_t> parity;
+		std::vector<uint8_t> id;
+
+	public:
+		EventBatchSoA() {}
+
+		EventBatchSoA(const Event* events, std::size_t n)
+		{ assign(events, n); }
+
+		explicit EventBatchSoA(const std::vector<Event>& v)
+		{ assign(v.data(), v.size()); }
+
+		std::size_t size() const
+		{ return t.size(); }
+
+		bool empty() const
+		{ return t.empty(); }
+
+		void clear()
+		{ resize(0); }
+
+		void reserve(std::size_t n)
+		{
+			t.reserve(n);
+			x.reserve(n);
+			y.reserve(n);
+			parity.reserve(n);
+			id.reserve(n);
+		}
+
+		void resize(std::size_t n)
+		{
+			t.resize(n);
+			x.resize(n);
+			y.resize(n);
+			parity.resize(n);
+			id.resize(n);
+		}
+
+		/** Replaces the content with 'n' events (capacity is kept) */
+		void assign(const Event* events, std::size_t n)
+		{
+			resize(0);
+			append(events, n);
+		}
+
+		void append(const Event* events, std::size_t n)
+		{
+			const std::size_t offset = size();
+			resize(offset + n);
+			uint64_t* pt = t.data() + offset;
+			uint16_t* px = x.data() + offset;
+			uint16_t* py = y.data() + offset;
+			uint8_t* pp = parity.data() + offset;
+			uint8_t* pi = id.data() + offset;
+			for(std::size_t i=0; i<n; i++) {
+				const Event& e = events[i];
+				pt[i] = e.t;
+				px[i] = e.x;
+				py[i] = e.y;
+				pp[i] = e.parity;
+				pi[i] = e.id;
+			}
+		}
+
+		void push_back(const Event& e)
+		{
+			t.push_back(e.t);
+			x.push_back(e.x);
+			y.push_back(e.y);
+			parity.push_back(e.parity);
+			id.push_back(e.id);
+		}
+
+		Event operator[](std::size_t i) const
+		{
+			Event e;
+			e.t = t[i];
+			e.x = x[i];
+			e.y = y[i];
+			e.parity = parity[i];
+			e.id = id[i];
+			return e;
+		}
+
+		/** Writes the events [begin, begin + n[ to 'out' */
+		void copy_to(std::size_t begin, std::size_t n, Event* out) const
+		{
+			for(std::size_t i=0; i<n; i++) {
+				out[i] = (*this)[begin + i];
+			}
+		}
+
+		std::vector<Event> to_vector() const
+		{
+			std::vector<Event> v(size());
+			copy_to(0, size(), v.data());
+			return v;
+		}
+
+		/** Index of the first event with timestamp greater or equal to 'time' */
+		std::size_t lower_bound(uint64_t time) const
+		{ return std::lower_bound(t.begin(), t.end(), time) - t.begin(); }
+
+		/** Index of the first event with timestamp greater than 'time' */
+		std::size_t upper_bound(uint64_t time) const
+		{ return std::upper_bound(t.begin(), t.end(), time) - t.begin(); }
+
+	};
+
+}
+
+#endif
@@ -0,0 +1,141 @@
+#include "EventFileView.hpp"
+#include "edvs.h"
+#include <iostream>
+#include <utility>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace Edvs
+{
+	bool IsMappable(const edvs_file_header_t& header)
+	{
+		// the compression field was added in version 2
+		return header.version <= EDVS_FILE_VERSION && header.encoding == EDVS_ENCODING_RAW
+			&& (header.version < 2 || header.compression == EDVS_COMPRESSION_NONE);
+	}
+
+	EventFileView::EventFileView()
+	: is_open_(false), map_(0), map_size_(0), events_(0), size_(0)
+	{}
+
+	EventFileView::EventFileView(const std::string& fn)
+	: EventFileView()
+	{
+		open(fn);
+	}
+
+	EventFileView::EventFileView(EventFileView&& other)
+	: is_open_(other.is_open_), map_(other.map_), map_size_(other.map_size_), events_(other.events_), size_(other.size_)
+	{
+		other.is_open_ = false;
+		other.map_ = 0;
+		other.map_size_ = 0;
+		other.events_ = 0;
+		other.size_ = 0;
+	}
+
+	EventFileView& EventFileView::operator=(EventFileView&& other)
+	{
+		if(this != &other) {
+			close();
+			std::swap(is_open_, other.is_open_);
+			std::swap(map_, other.map_);
+			std::swap(map_size_, other.map_size_);
+			std::swap(events_, other.events_);
+			std::swap(size_, other.size_);
+		}
+		return *this;
+	}
+
+	EventFileView::~EventFileView()
+	{
+		close();
+	}
+
+	bool EventFileView::open(const std::string& fn)
+	{
+		close();
+		int fd = ::open(fn.c_str(), O_RDONLY);
+		if(fd < 0) {
+			std::cerr << "Error opening file '" << fn << "'!" << std::endl;
+			return false;
+		}
+		struct stat st;
+		if(fstat(fd, &st) != 0) {
+			std::cerr << "Error reading size of file '" << fn << "'!" << std::endl;
+			::close(fd);
+			return false;
+		}
+		const std::size_t file_size = st.st_size;
+		// files with header: events are stored in one piece after the header
+		edvs_file_header_t header;
+		std::size_t offset = 0;
+		std::size_t num_bytes = file_size;
+		if(file_size >= sizeof(header) && pread(fd, &header, sizeof(header), 0) == sizeof(header)
+				&& std::memcmp(header.magic, EDVS_FILE_MAGIC, 8) == 0) {
+			if(!IsMappable(header)) {
+				std::cerr << "Error: file '" << fn << "' uses an encoding or compression which can not be mapped, use LoadEvents!" << std::endl;
+				::close(fd);
+				return false;
+			}
+			offset = header.header_size;
+			num_bytes = (header.index_offset != 0)
+				? header.num_events*sizeof(Event)
+				: file_size - offset;
+		}
+		if(num_bytes % sizeof(Event) != 0) {
+			std::cerr << "Warning: size of file '" << fn << "' is not a multiple of the event size, ignoring the last "
+				<< num_bytes % sizeof(Event) << " bytes" << std::endl;
+		}
+		if(num_bytes < sizeof(Event)) {
+			// mmap does not support empty mappings
+			::close(fd);
+			is_open_ = true;
+			return true;
+		}
+		void* p = mmap(0, offset + num_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+		// the mapping stays valid after closing the file
+		::close(fd);
+		if(p == MAP_FAILED) {
+			std::cerr << "Error mapping file '" << fn << "'!" << std::endl;
+			return false;
+		}
+		is_open_ = true;
+		map_ = p;
+		map_size_ = offset + num_bytes;
+		events_ = reinterpret_cast<const Event*>(static_cast<const char*>(p) + offset);
+		size_ = num_bytes / sizeof(Event);
+		advise_sequential();
+		return true;
+	}
+
+	void EventFileView::close()
+	{
+		if(map_ != 0) {
+			munmap(map_, map_size_);
+		}
+		is_open_ = false;
+		map_ = 0;
+		map_size_ = 0;
+		events_ = 0;
+		size_ = 0;
+	}
+
+	void EventFileView::advise_sequential() const
+	{
+		if(map_size_ > 0) {
+			madvise(map_, map_size_, MADV_SEQUENTIAL);
+		}
+	}
+
+	void EventFileView::advise_random() const
+	{
+		if(map_size_ > 0) {
+			madvise(map_, map_size_, MADV_RANDOM);
+		}
+	}
+
+}
@@ -0,0 +1,91 @@
+#ifndef INCLUDE_EDVS_EVENTFILEVIEW_HPP
+#define INCLUDE_EDVS_EVENTFILEVIEW_HPP
+
+#include "Event.hpp"
+#include "edvs.h"
+#include <string>
+#include <cstddef>
+
+namespace Edvs
+{
+
+	/** Whether the events of a file with this header are stored uncompressed in one piece
+	 * Other files can not be mapped and have to be read with LoadEvents or edvs_file_reader.
+	 */
+	bool IsMappable(const edvs_file_header_t& header);
+
+	/** Read-only view of a binary event file which is mapped into memory
+	 * Events are not loaded or copied. The operating system reads pages on
+	 * demand and can evict them again, so recordings larger than the main
+	 * memory can be processed.
+	 */
+	class EventFileView
+	{
+	public:
+		typedef const Event* const_iterator;
+
+		EventFileView();
+
+		/** Maps the file, see 'open' */
+		EventFileView(const std::string& fn);
+
+		EventFileView(const EventFileView&) = delete;
+		EventFileView& operator=(const EventFileView&) = delete;
+
+		EventFileView(EventFileView&& other);
+		EventFileView& operator=(EventFileView&& other);
+
+		~EventFileView();
+
+		/** Maps an event file written with SaveEvents (raw encoding) or a file without header
+		 * Hints the operating system that events are accessed sequentially.
+		 * @return false if the file could not be mapped
+		 */
+		bool open(const std::string& fn);
+
+		void close();
+
+		bool is_open() const
+		{ return is_open_; }
+
+		std::size_t size() const
+		{ return size_; }
+
+		bool empty() const
+		{ return size_ == 0; }
+
+		const Event* data() const
+		{ return events_; }
+
+		const_iterator begin() const
+		{ return events_; }
+
+		const_iterator end() const
+		{ return events_ + size_; }
+
+		const Event& operator[](std::size_t i) const
+		{ return events_[i]; }
+
+		const Event& front() const
+		{ return events_[0]; }
+
+		const Event& back() const
+		{ return events_[size_ - 1]; }
+
+		/** Hints the operating system that events are accessed in order (read ahead) */
+		void advise_sequential() const;
+
+		/** Hints the operating system that events are accessed randomly (no read ahead) */
+		void advise_random() const;
+
+	private:
+		bool is_open_;
+		void* map_;
+		std::size_t map_size_;
+		const Event* events_;
+		std::size_t size_;
+	};
+
+}
+
+#endif
@@ -1,21 +1,105 @@
 #include "EventIO.hpp"
 #include "edvs.h"
 #include <stdio.h>
+#include <algorithm>
+#include <limits>
 
 namespace Edvs
 {
+	EventFileHeader CreateEventFileHeader(const Event* events, std::size_t n)
+	{
+		EventFileHeader header;
+		edvs_file_header_init(&header);
+		bool has_id[EDVS_FILE_MAX_SENSORS] = { false };
+		for(std::size_t i=0; i<n; i++) {
+			has_id[events[i].id] = true;
+		}
+		for(unsigned id=0; id<EDVS_FILE_MAX_SENSORS; id++) {
+			if(has_id[id]) {
+				header.sensor_ids[header.num_sensors++] = id;
+			}
+		}
+		return header;
+	}
+
 	void SaveEvents(const std::string& fn, const std::vector<Event>& v)
+	{
+		SaveEvents(fn, v.data(), v.size());
+	}
+
+	void SaveEvents(const std::string& fn, const Event* events, std::size_t n)
+	{
+		SaveEvents(fn, events, n, CreateEventFileHeader(events, n));
+	}
+
+	void SaveEvents(const std::string& fn, const Event* events, std::size_t n, const EventFileHeader& header)
 	{
 		FILE* f = fopen(fn.c_str(), "w");
 		if(f == 0) {
 			std::cerr << "Error opening file '" << fn << "'!" << std::endl;
 			return;
 		}
-		edvs_file_write(f, v.data(), v.size());
+		edvs_file_writer_t* w = edvs_file_writer_open(f, &header);
+		if(w) {
+			edvs_file_writer_write(w, events, n);
+			edvs_file_writer_close(w);
+		}
 		fclose(f);
 	}
 
+	/** Upper bound for the number of events from the current position to the first event with timestamp >= t_end
+	 * Uses the chunk index if it is available, 0 if the number is not known.
+	 */
+	uint64_t NumEventsBefore(edvs_file_reader_t* r, uint64_t t_end)
+	{
+		if(t_end == std::numeric_limits<uint64_t>::max()) {
+			return (r->header.num_events > r->position) ? r->header.num_events - r->position : 0;
+		}
+		// do not rebuild a missing index only to reserve memory
+		if(r->chunks == 0 && r->header.index_offset == 0) {
+			return 0;
+		}
+		size_t num_chunks = 0;
+		const edvs_file_chunk_t* chunks = edvs_file_reader_index(r, &num_chunks);
+		uint64_t end = 0;
+		for(size_t k=0; k<num_chunks && chunks[k].t < t_end; k++) {
+			end += chunks[k].n;
+		}
+		return (end > r->position) ? end - r->position : 0;
+	}
+
+	/** Reads events from the current position until the first event with timestamp >= t_end */
+	std::vector<Event> ReadEvents(edvs_file_reader_t* r, uint64_t t_end)
+	{
+		std::vector<Event> v;
+		// only the events of the requested time range, not the rest of the file
+		v.reserve(NumEventsBefore(r, t_end));
+		const size_t num_max = 65536;
+		while(true) {
+			const std::size_t offset = v.size();
+			v.resize(offset + num_max);
+			ssize_t m = edvs_file_reader_read(r, v.data() + offset, num_max);
+			m = std::max<ssize_t>(m, 0);
+			v.resize(offset + m);
+			if(t_end != std::numeric_limits<uint64_t>::max()) {
+				// events are ordered, so only the last block can contain later events
+				auto it = std::lower_bound(v.begin() + offset, v.end(), t_end,
+					[](const Event& e, uint64_t t) { return e.t < t; });
+				v.erase(it, v.end());
+			}
+			if(m != num_max || v.size() != offset + m) {
+				break;
+			}
+		}
+		return v;
+	}
+
 	std::vector<Event> LoadEvents(const std::string& fn)
+	{
+		return LoadEvents(fn, 0, std::numeric_limits<uint64_t>::max());
+	}
+
+	std::vector<Event> LoadEvents(const std::string& fn, uint64_t t_begin, uint64_t t_end)
 	{
 		std::vector<Event> v;
 		FILE* f = fopen(fn.c_str(), "r");
@@ -23,17 +107,32 @@ namespace Edvs
 			std::cerr << "Error opening file '" << fn << "'!" << std::endl;
 			return v;
 		}
-		const size_t num_max = 1024;
-		std::vector<edvs_event_t> buffer(num_max);
-		while(true) {
-			ssize_t m = edvs_file_read(f, buffer.data(), num_max);
-			v.insert(v.end(), buffer.begin(), buffer.begin() + m);
-			if(m != num_max) {
-				break;
+		edvs_file_reader_t* r = edvs_file_reader_open(f);
+		if(r) {
+			if(t_begin > 0) {
+				edvs_file_reader_seek(r, t_begin);
 			}
+			v = ReadEvents(r, t_end);
+			edvs_file_reader_close(r);
 		}
 		fclose(f);
 		return v;
 	}
 
-}
\ No newline at end of file
+	bool LoadEventFileHeader(const std::string& fn, EventFileHeader& header)
+	{
+		FILE* f = fopen(fn.c_str(), "r");
+		if(f == 0) {
+			std::cerr << "Error opening file '" << fn << "'!" << std::endl;
+			return false;
+		}
+		edvs_file_reader_t* r = edvs_file_reader_open(f);
+		if(r) {
+			header = r->header;
+			edvs_file_reader_close(r);
+		}
+		fclose(f);
+		return r != 0;
+	}
+
+}
@@ -2,16 +2,36 @@
 #define INCLUDE_EDVS_EVENTIO_HPP
 
 #include "Event.hpp"
+#include "edvs.h"
 #include <string>
 #include <vector>
 
 namespace Edvs
 {
+	typedef edvs_file_header_t EventFileHeader;
 
+	/** Header with default values and the ids of the sensors which occur in 'events' */
+	EventFileHeader CreateEventFileHeader(const Event* events, std::size_t n);
+
+	/** Saves events in the event file format with header and chunk index */
 	void SaveEvents(const std::string& fn, const std::vector<Event>& v);
 
+	void SaveEvents(const std::string& fn, const Event* events, std::size_t n);
+
+	void SaveEvents(const std::string& fn, const Event* events, std::size_t n, const EventFileHeader& header);
+
+	/** Loads all events of an event file (with or without header) */
 	std::vector<Event> LoadEvents(const std::string& fn);
 
+	/** Loads events with timestamp in [t_begin, t_end[ using the chunk index */
+	std::vector<Event> LoadEvents(const std::string& fn, uint64_t t_begin, uint64_t t_end);
+
+	/** Reads the header of an event file
+	 * For files without header, the version is 0 and default values are used.
+	 * @return false if the file could not be read
+	 */
+	bool LoadEventFileHeader(const std::string& fn, EventFileHeader& header);
+
 }
 
 #endif
@@ -0,0 +1,215 @@
+#include "EventRecorder.hpp"
+#include "edvs.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace Edvs
+{
+	/** Number of events taken from the queue at once */
+	const std::size_t cRecorderBlockSize = 65536;
+
+	/** Alignment of the file buffer and block size of direct writes */
+	const std::size_t cRecorderAlignment = 4096;
+
+	/** Longest time the writer thread sleeps if the queue is empty */
+	const std::chrono::milliseconds cRecorderMaxWait(10);
+
+	EventRecorder::EventRecorder(const std::string& fn, const EventRecorderParameters& params)
+	: fn_(fn), params_(params), queue_(params.queue_capacity, params.overflow_policy),
+	  is_open_(false), stop_(false),
+	  num_recorded_(0), num_written_(0), num_lost_(0), num_files_(0), has_error_(false),
+	  fd_(-1), fh_(0), writer_(0), is_direct_(false), buffer_(0), buffer_size_(0), file_begin_time_(0)
+	{
+		// a chunk is written with one call and must fit into the buffer,
+		// otherwise the C library writes it directly from unaligned memory
+		const std::size_t chunk_size = (params_.header.chunk_size == 0) ? EDVS_FILE_DEFAULT_CHUNK_SIZE : params_.header.chunk_size;
+		std::size_t size = std::max<std::size_t>(params_.write_buffer_size, 2*chunk_size*EDVS_DELTA_MAX_EVENT_BYTES);
+		buffer_size_ = (size + cRecorderAlignment - 1) / cRecorderAlignment * cRecorderAlignment;
+		void* p;
+		if(posix_memalign(&p, cRecorderAlignment, buffer_size_) != 0) {
+			std::cerr << "EventRecorder: out of memory" << std::endl;
+			return;
+		}
+		buffer_ = static_cast<char*>(p);
+		if(!openFile()) {
+			return;
+		}
+		is_open_ = true;
+		thread_ = std::thread(&EventRecorder::runImpl, this);
+	}
+
+	EventRecorder::~EventRecorder()
+	{
+		stop();
+		free(buffer_);
+	}
+
+	std::size_t EventRecorder::record(const Event* events, std::size_t n)
+	{
+		if(!is_open_ || stop_) {
+			return 0;
+		}
+		const std::size_t m = queue_.push(events, n);
+		num_recorded_ += m;
+		cv_.notify_one();
+		return m;
+	}
+
+	void EventRecorder::stop()
+	{
+		if(thread_.joinable()) {
+			stop_ = true;
+			cv_.notify_one();
+			thread_.join();
+		}
+		closeFile();
+	}
+
+	std::string EventRecorder::file_name(std::size_t k) const
+	{
+		if(params_.max_file_size == 0 && params_.max_file_duration == 0) {
+			return fn_;
+		}
+		// insert the number in front of the extension
+		const std::size_t slash = fn_.find_last_of('/');
+		std::size_t dot = fn_.find_last_of('.');
+		if(dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+			dot = fn_.size();
+		}
+		char num[32];
+		snprintf(num, sizeof(num), "_%04zu", k);
+		return fn_.substr(0, dot) + num + fn_.substr(dot);
+	}
+
+	void EventRecorder::runImpl()
+	{
+		std::vector<Event> block(cRecorderBlockSize);
+		while(true) {
+			std::size_t n = queue_.pop(block.data(), block.size());
+			if(n == 0) {
+				if(stop_) {
+					// 'record' is not called anymore, so the queue stays empty
+					if(queue_.empty()) {
+						break;
+					}
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(mtx_);
+				cv_.wait_for(lock, cRecorderMaxWait);
+				continue;
+			}
+			write(block.data(), n);
+		}
+	}
+
+	void EventRecorder::write(const Event* events, std::size_t n)
+	{
+		std::size_t i = 0;
+		while(i < n) {
+			// do not continue after an error, a new file could replace the recording
+			if(has_error_ || (writer_ == 0 && !openFile())) {
+				num_lost_ += n - i;
+				return;
+			}
+			if(writer_->header.num_events == 0) {
+				file_begin_time_ = events[i].t;
+			}
+			// events up to the time limit of the current file
+			std::size_t m = n - i;
+			if(params_.max_file_duration > 0) {
+				const Event* end = std::lower_bound(events + i, events + n, file_begin_time_ + params_.max_file_duration,
+					[](const Event& e, uint64_t t) { return e.t < t; });
+				m = end - (events + i);
+			}
+			if(m > 0) {
+				if(edvs_file_writer_write(writer_, events + i, m) < 0) {
+					has_error_ = true;
+					num_lost_ += n - i;
+					closeFile();
+					return;
+				}
+				for(std::size_t j=i; j<i+m; j++) {
+					has_id_[events[j].id] = true;
+				}
+				num_written_ += m;
+				i += m;
+			}
+			if(i < n || (params_.max_file_size > 0 && writer_->offset >= params_.max_file_size)) {
+				closeFile();
+			}
+		}
+	}
+
+	bool EventRecorder::openFile()
+	{
+		const std::string fn = file_name(num_files_);
+		int flags = O_WRONLY | O_CREAT | O_TRUNC;
+		fd_ = -1;
+		is_direct_ = false;
+		if(params_.direct_io) {
+			fd_ = ::open(fn.c_str(), flags | O_DIRECT, 0644);
+			is_direct_ = (fd_ >= 0);
+			if(fd_ < 0) {
+				std::cerr << "EventRecorder: direct I/O not available for '" << fn << "', using buffered writes" << std::endl;
+			}
+		}
+		if(fd_ < 0) {
+			fd_ = ::open(fn.c_str(), flags, 0644);
+		}
+		if(fd_ < 0 || (fh_ = fdopen(fd_, "wb")) == 0) {
+			std::cerr << "Error opening file '" << fn << "'!" << std::endl;
+			if(fd_ >= 0) {
+				::close(fd_);
+			}
+			fd_ = -1;
+			has_error_ = true;
+			return false;
+		}
+		// the buffer is only flushed when it is full, so all writes are aligned
+		setvbuf(fh_, buffer_, _IOFBF, buffer_size_);
+		writer_ = edvs_file_writer_open(fh_, &params_.header);
+		if(writer_ == 0) {
+			fclose(fh_);
+			fh_ = 0;
+			fd_ = -1;
+			has_error_ = true;
+			return false;
+		}
+		std::fill(has_id_, has_id_ + EDVS_FILE_MAX_SENSORS, false);
+		num_files_++;
+		return true;
+	}
+
+	void EventRecorder::closeFile()
+	{
+		if(writer_ == 0) {
+			return;
+		}
+		// sensors which occur in the file
+		writer_->header.num_sensors = 0;
+		for(unsigned id=0; id<EDVS_FILE_MAX_SENSORS; id++) {
+			if(has_id_[id]) {
+				writer_->header.sensor_ids[writer_->header.num_sensors++] = id;
+			}
+		}
+		if(is_direct_) {
+			// the remaining bytes are not a multiple of the block size
+			fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT);
+		}
+		if(edvs_file_writer_close(writer_) != 0) {
+			has_error_ = true;
+		}
+		if(fclose(fh_) != 0) {
+			has_error_ = true;
+		}
+		writer_ = 0;
+		fh_ = 0;
+		fd_ = -1;
+	}
+
+}
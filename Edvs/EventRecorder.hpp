@@ -0,0 +1,153 @@
+#ifndef INCLUDE_EDVS_EVENTRECORDER_HPP
+#define INCLUDE_EDVS_EVENTRECORDER_HPP
+
+#include "Event.hpp"
+#include "EventIO.hpp"
+#include "EventRingBuffer.hpp"
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdio.h>
+#include <stdint.h>
+
+namespace Edvs
+{
+
+	/** Parameters used when recording events */
+	struct EventRecorderParameters
+	{
+		EventRecorderParameters()
+		: queue_capacity(1<<22), overflow_policy(OverflowPolicy::DropNewest),
+		  write_buffer_size(8<<20), direct_io(false),
+		  max_file_size(0), max_file_duration(0)
+		{
+			edvs_file_header_init(&header);
+		}
+
+		/** Encoding, compression, chunk size and sensor size of the written files
+		 * The sensor ids are set to the ids which occur in each file.
+		 */
+		EventFileHeader header;
+
+		/** Maximum number of events queued between 'record' and the writer thread */
+		std::size_t queue_capacity;
+
+		/** What happens if the writer thread does not keep up */
+		OverflowPolicy overflow_policy;
+
+		/** Size of the file buffer in bytes
+		 * Rounded up to a multiple of 4096 bytes and large enough for one chunk.
+		 * The file is written in blocks of this size.
+		 */
+		std::size_t write_buffer_size;
+
+		/** Open files with O_DIRECT to bypass the page cache
+		 * Falls back to normal writes if the file system does not support it.
+		 */
+		bool direct_io;
+
+		/** Starts a new file once a file has at least this many bytes (0 for no limit) */
+		uint64_t max_file_size;
+
+		/** Starts a new file once a file spans this much event time (0 for no limit) */
+		uint64_t max_file_duration;
+	};
+
+	/** Writes events to event files on a background thread
+	 * Events are passed to 'record' and queued in a bounded ring buffer, so the
+	 * caller never waits for the disk. Events which do not fit into the queue
+	 * are dropped and counted (see EventRecorderParameters::overflow_policy).
+	 * If a file size or duration limit is set, the recording is split into
+	 * files 'name_0000.ext', 'name_0001.ext', ... instead of 'name.ext'.
+	 * Only one thread may call 'record'.
+	 */
+	class EventRecorder
+	{
+	public:
+		/** Opens the first file and starts the writer thread */
+		EventRecorder(const std::string& fn, const EventRecorderParameters& params=EventRecorderParameters());
+
+		EventRecorder(const EventRecorder&) = delete;
+		EventRecorder& operator=(const EventRecorder&) = delete;
+
+		/** Stops recording, see 'stop' */
+		~EventRecorder();
+
+		/** False if the first file could not be opened */
+		bool is_open() const
+		{ return is_open_; }
+
+		/** Queues events for writing
+		 * @return number of events taken, see EventRingBuffer::push
+		 */
+		std::size_t record(const Event* events, std::size_t n);
+
+		std::size_t record(const std::vector<Event>& events)
+		{ return record(events.data(), events.size()); }
+
+		/** Writes all queued events, closes the current file and stops the writer thread */
+		void stop();
+
+		/** Number of events passed to 'record' */
+		uint64_t num_recorded() const
+		{ return num_recorded_.load(); }
+
+		/** Number of events written to files */
+		uint64_t num_written() const
+		{ return num_written_.load(); }
+
+		/** Number of events lost because the queue was full or a file could not be written */
+		uint64_t num_dropped() const
+		{ return queue_.num_dropped() + num_lost_.load(); }
+
+		/** Number of files which have been started */
+		std::size_t num_files() const
+		{ return num_files_.load(); }
+
+		/** Name of the k-th file of the recording */
+		std::string file_name(std::size_t k) const;
+
+		/** True if a file could not be opened or written */
+		bool has_error() const
+		{ return has_error_.load(); }
+
+	private:
+		void runImpl();
+
+		void write(const Event* events, std::size_t n);
+
+		bool openFile();
+
+		void closeFile();
+
+	private:
+		std::string fn_;
+		EventRecorderParameters params_;
+		EventRingBuffer queue_;
+		bool is_open_;
+		std::thread thread_;
+		std::mutex mtx_;
+		std::condition_variable cv_;
+		std::atomic<bool> stop_;
+		std::atomic<uint64_t> num_recorded_;
+		std::atomic<uint64_t> num_written_;
+		std::atomic<uint64_t> num_lost_;
+		std::atomic<std::size_t> num_files_;
+		std::atomic<bool> has_error_;
+		// current file (writer thread only after the constructor)
+		int fd_;
+		FILE* fh_;
+		edvs_file_writer_t* writer_;
+		bool is_direct_;
+		char* buffer_;
+		std::size_t buffer_size_;
+		uint64_t file_begin_time_;
+		bool has_id_[EDVS_FILE_MAX_SENSORS];
+	};
+
+}
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef INCLUDE_EDVS_EVENTRINGBUFFER_HPP
+#define INCLUDE_EDVS_EVENTRINGBUFFER_HPP
+
+#include "Event.hpp"
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+namespace Edvs
+{
+
+	/** Determines what happens if events are added to a full buffer */
+	enum class OverflowPolicy
+	{
+		DropOldest, // discard the oldest buffered events to make room
+		DropNewest, // discard the new events which do not fit
+		Block // discard nothing, the producer has to wait until there is room
+	};
+
+	/** A fixed-capacity lock-free single-producer/single-consumer ring buffer of events
+	 * Exactly one thread may call 'push' and exactly one other thread may call
+	 * 'pop'. The capacity is rounded up to the next power of two.
+	 * Read and write positions are free running 64 bit counters, so there is no
+	 * ambiguity between an empty and a full buffer.
+	 * The consumer advances the read position with a compare-and-swap. This allows
+	 * the producer to discard old events (OverflowPolicy::DropOldest) while the
+	 * consumer is copying them; the consumer notices and retries.
+	 */
+	class EventRingBuffer
+	{
+	public:
+		EventRingBuffer(std::size_t capacity=1024, OverflowPolicy policy=OverflowPolicy::Block)
+		: policy_(policy), head_(0), tail_(0), num_dropped_(0)
+		{
+			std::size_t n = 1;
+			while(n < capacity) {
+				n *= 2;
+			}
+			mask_ = n - 1;
+			data_.resize(n);
+		}
+
+		EventRingBuffer(const EventRingBuffer&) = delete;
+		EventRingBuffer& operator=(const EventRingBuffer&) = delete;
+
+		std::size_t capacity() const
+		{ return data_.size(); }
+
+		OverflowPolicy policy() const
+		{ return policy_; }
+
+		/** Number of events currently in the buffer */
+		std::size_t size() const
+		{
+			const uint64_t tail = tail_.load(std::memory_order_acquire);
+			const uint64_t head = head_.load(std::memory_order_acquire);
+			// the producer can discard and add events between the two loads
+			return std::min(static_cast<std::size_t>(head - tail), capacity());
+		}
+
+		bool empty() const
+		{ return size() == 0; }
+
+		/** Total number of events which were discarded due to overflow */
+		uint64_t num_dropped() const
+		{ return num_dropped_.load(std::memory_order_relaxed); }
+
+		/** Adds events to the buffer (producer only)
+		 * @return number of events taken from 'events'. For OverflowPolicy::Block
+		 * 		this can be less than 'n' and the caller has to push the remaining
+		 * 		events later. For the drop policies all events count as taken.
+		 */
+		std::size_t push(const edvs_event_t* events, std::size_t n)
+		{
+			const std::size_t cap = capacity();
+			const uint64_t head = head_.load(std::memory_order_relaxed);
+			uint64_t tail = tail_.load(std::memory_order_acquire);
+			std::size_t num_free = cap - static_cast<std::size_t>(head - tail);
+			std::size_t num_taken = n;
+			if(n > num_free) {
+				switch(policy_) {
+				case OverflowPolicy::Block:
+					n = num_free;
+					num_taken = n;
+					break;
+				case OverflowPolicy::DropNewest:
+					num_dropped_.fetch_add(n - num_free, std::memory_order_relaxed);
+					n = num_free;
+					break;
+				case OverflowPolicy::DropOldest:
+					if(n > cap) {
+						// only the newest events fit at all
+						num_dropped_.fetch_add(n - cap, std::memory_order_relaxed);
+						events += n - cap;
+						n = cap;
+					}
+					// move the read position forward to make room
+					while(n > num_free) {
+						const uint64_t num_discard = n - num_free;
+						if(tail_.compare_exchange_weak(tail, tail + num_discard,
+								std::memory_order_acq_rel, std::memory_order_acquire)) {
+							num_dropped_.fetch_add(num_discard, std::memory_order_relaxed);
+							break;
+						}
+						// consumer was faster, 'tail' holds the new read position
+						num_free = cap - static_cast<std::size_t>(head - tail);
+					}
+					break;
+				}
+			}
+			if(n > 0) {
+				copy_in(head, events, n);
+				head_.store(head + n, std::memory_order_release);
+			}
+			return num_taken;
+		}
+
+		/** Removes up to 'n' events from the buffer (consumer only)
+		 * @return number of events written to 'out'
+		 */
+		std::size_t pop(edvs_event_t* out, std::size_t n)
+		{
+			uint64_t tail = tail_.load(std::memory_order_acquire);
+			while(true) {
+				const uint64_t head = head_.load(std::memory_order_acquire);
+				if(head - tail > capacity()) {
+					// producer discarded events and wrote over them after we read 'tail'
+					tail = tail_.load(std::memory_order_acquire);
+					continue;
+				}
+				const std::size_t m = std::min<std::size_t>(n, head - tail);
+				if(m == 0) {
+					return 0;
+				}
+				copy_out(tail, out, m);
+				if(tail_.compare_exchange_strong(tail, tail + m,
+						std::memory_order_acq_rel, std::memory_order_acquire)) {
+					return m;
+				}
+				// producer discarded events while we were copying => try again
+			}
+		}
+
+		/** Discards all buffered events (consumer only) */
+		void clear()
+		{
+			uint64_t tail = tail_.load(std::memory_order_acquire);
+			while(!tail_.compare_exchange_weak(tail, head_.load(std::memory_order_acquire),
+					std::memory_order_acq_rel, std::memory_order_acquire)) {
+				// producer discarded events, 'tail' holds the new read position
+			}
+		}
+
+		/** Removes up to 'n' events with timestamp smaller than 't' (consumer only)
+		 * Events are expected to be ordered by timestamp.
+		 * @return number of events written to 'out'
+		 */
+		std::size_t pop_before(uint64_t t, edvs_event_t* out, std::size_t n)
+		{
+			uint64_t tail = tail_.load(std::memory_order_acquire);
+			while(true) {
+				const uint64_t head = head_.load(std::memory_order_acquire);
+				if(head - tail > capacity()) {
+					tail = tail_.load(std::memory_order_acquire);
+					continue;
+				}
+				// binary search for the first event with timestamp >= t
+				uint64_t a = tail;
+				uint64_t b = tail + std::min<std::size_t>(n, head - tail);
+				while(a < b) {
+					const uint64_t c = a + (b - a)/2;
+					if(data_[static_cast<std::size_t>(c) & mask_].t < t) {
+						a = c + 1;
+					}
+					else {
+						b = c;
+					}
+				}
+				const std::size_t m = static_cast<std::size_t>(a - tail);
+				if(m == 0) {
+					return 0;
+				}
+				copy_out(tail, out, m);
+				if(tail_.compare_exchange_strong(tail, tail + m,
+						std::memory_order_acq_rel, std::memory_order_acquire)) {
+					return m;
+				}
+			}
+		}
+
+	private:
+		void copy_in(uint64_t pos, const edvs_event_t* events, std::size_t n)
+		{
+			const std::size_t i = static_cast<std::size_t>(pos) & mask_;
+			const std::size_t n1 = std::min(n, capacity() - i);
+			std::memcpy(data_.data() + i, events, n1*sizeof(edvs_event_t));
+			std::memcpy(data_.data(), events + n1, (n - n1)*sizeof(edvs_event_t));
+		}
+
+		void copy_out(uint64_t pos, edvs_event_t* out, std::size_t n) const
+		{
+			const std::size_t i = static_cast<std::size_t>(pos) & mask_;
+			const std::size_t n1 = std::min(n, capacity() - i);
+			std::memcpy(out, data_.data() + i, n1*sizeof(edvs_event_t));
+			std::memcpy(out + n1, data_.data(), (n - n1)*sizeof(edvs_event_t));
+		}
+
+	private:
+		OverflowPolicy policy_;
+		std::vector<edvs_event_t> data_;
+		std::size_t mask_;
+		// producer and consumer positions live on separate cache lines
+		// Explicit padding instead of alignas: the buffer is allocated with plain
+		// new inside the event streams, which does not honour over-alignment before C++17.
+		// A full line between the counters keeps them apart for any start address.
+		static const std::size_t cCacheLineSize = 64;
+		char pad0_[cCacheLineSize];
+		std::atomic<uint64_t> head_;
+		char pad1_[cCacheLineSize - sizeof(std::atomic<uint64_t>)];
+		std::atomic<uint64_t> tail_;
+		char pad2_[cCacheLineSize - sizeof(std::atomic<uint64_t>)];
+		std::atomic<uint64_t> num_dropped_;
+		char pad3_[cCacheLineSize - sizeof(std::atomic<uint64_t>)];
+	};
+
+}
+
+#endif
@@ -2,24 +2,104 @@
 #include "edvs.h"
 #include "Event.hpp"
 #include <thread>
+#include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include <string>
 #include <vector>
 #include <algorithm>
 #include <memory>
 #include <limits>
+#include <functional>
+#include <utility>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
 
 namespace Edvs
 {
+	/** Wakes up readers which wait for new events
+	 * Capture threads call 'notify' after they delivered events. The mutex is
+	 * only taken if a reader is actually waiting.
+	 */
+	class EventNotifier
+	{
+	public:
+		EventNotifier()
+		: generation_(0), num_waiting_(0)
+		{}
+
+		/** Incremented for each notification */
+		uint64_t generation() const
+		{ return generation_.load(); }
+
+		void notify()
+		{
+			generation_++;
+			if(num_waiting_.load() > 0) {
+				std::lock_guard<std::mutex> lock(mtx_);
+				cv_.notify_all();
+			}
+		}
+
+		/** Blocks until 'pred' is true or the deadline has passed
+		 * @return value of 'pred' after waiting
+		 */
+		template<typename Pred>
+		bool wait_until(const std::chrono::steady_clock::time_point& deadline, Pred pred)
+		{
+			if(pred()) {
+				return true;
+			}
+			num_waiting_++;
+			bool result;
+			{
+				std::unique_lock<std::mutex> lock(mtx_);
+				result = cv_.wait_until(lock, deadline, pred);
+			}
+			num_waiting_--;
+			return result;
+		}
+
+	private:
+		std::atomic<uint64_t> generation_;
+		std::atomic<int> num_waiting_;
+		std::mutex mtx_;
+		std::condition_variable cv_;
+	};
+
+	/** Pins the calling thread to a CPU, does nothing for cpu < 0 */
+	void PinCurrentThread(int cpu)
+	{
+		if(cpu < 0) {
+			return;
+		}
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+			std::cerr << "Could not pin capture thread to CPU " << cpu << std::endl;
+		}
+	}
+
 	class SingleEventStream : public IEventStream
 	{
 	public:
-		SingleEventStream() {}
+		SingleEventStream(const EventStreamParameters& params=EventStreamParameters())
+		: is_running_(false), is_finished_(false),
+		  events_(params.buffer_capacity, params.overflow_policy),
+		  notifier_(std::make_shared<EventNotifier>()),
+		  capture_cpu_(params.capture_cpu),
+		  h(0), last_time_(0), last_captured_time_(0)
+		{}
 
 		SingleEventStream(const SingleEventStream&) = delete;
 		SingleEventStream& operator=(const SingleEventStream&) = delete;
 		
-		SingleEventStream(const std::string& uri)
+		SingleEventStream(const std::string& uri, const EventStreamParameters& params=EventStreamParameters())
+		: SingleEventStream(params)
 		{
 			open(uri);
 			run();
@@ -38,24 +118,87 @@ namespace Edvs
 		void close()
 		{
 			if(is_open()) {
-				if(is_running_) {
-					is_running_ = false;
-					thread_.join();
-				}
+				stop();
 				if(h) {
 					edvs_close(h);
+					h = 0;
 				}
 			}
 		}
 
+		/** Stops capturing events but leaves the stream open */
+		void stop()
+		{
+			if(is_running_) {
+				is_running_ = false;
+				if(thread_.joinable()) {
+					thread_.join();
+				}
+				notifier_->notify();
+			}
+		}
+
+		/** Sets the notifier which is signaled when new events arrive
+		 * Must be called before 'run'.
+		 */
+		void set_notifier(const std::shared_ptr<EventNotifier>& notifier)
+		{
+			notifier_ = notifier;
+		}
+
 		void run()
 		{
 			last_time_ = 0;
+			last_captured_time_ = 0;
 			edvs_run(h);
 			is_running_ = true;
+			is_finished_ = false;
 			thread_ = std::thread(&SingleEventStream::runImpl, this);
 		}
 
+		/** Starts streaming without a capture thread
+		 * The owner has to call 'poll' whenever the file descriptor is readable.
+		 */
+		void run_polled()
+		{
+			last_time_ = 0;
+			last_captured_time_ = 0;
+			edvs_run(h);
+			is_running_ = true;
+			is_finished_ = false;
+		}
+
+		/** File descriptor of a device stream or -1 for file streams */
+		int fd() const
+		{
+			return edvs_get_fd(h);
+		}
+
+		/** Reads available data from the device and delivers the events
+		 * Only call if the file descriptor is readable and the stream was
+		 * started with 'run_polled'.
+		 * @return false if the connection was closed
+		 */
+		bool poll()
+		{
+			const ssize_t num_bytes = edvs_fill(h);
+			const std::size_t num_max = 1024;
+			edvs_event_t buffer[num_max];
+			while(true) {
+				ssize_t m = edvs_read_buffered(h, buffer, num_max);
+				if(m <= 0) {
+					break;
+				}
+				push_events(buffer, m);
+			}
+			if(num_bytes <= 0) {
+				is_finished_ = true;
+				notifier_->notify();
+				return false;
+			}
+			return true;
+		}
+
 		bool is_open() const
 		{
 			return h;
@@ -73,8 +216,8 @@ namespace Edvs
 
 		bool eos() const
 		{
-			std::lock_guard<std::mutex> lock(mtx_);
-			return is_open() && edvs_eos(h) && events_.empty();
+			// the capture thread sets the flag after it delivered the last events
+			return is_open() && is_finished_ && events_.empty();
 		}
 
 		bool is_live() const
@@ -82,20 +225,91 @@ namespace Edvs
 			return edvs_is_live(h) == 1;
 		}
 
-		std::vector<edvs_event_t> read()
+		using IEventStream::read;
+		using IEventStream::read_wait;
+		using IEventStream::read_until;
+
+		std::size_t read(edvs_event_t* events, std::size_t capacity)
 		{
 			if(!is_open()) {
-				return {};
+				return 0;
 			}
-			else {
-				std::vector<edvs_event_t> v = pop_events();
-				if(!v.empty()) {
-					last_time_ = v.back().t;
-				}
-				return v;
+			std::size_t n = events_.pop(events, capacity);
+			if(n > 0) {
+				last_time_ = events[n-1].t;
 			}
+			return n;
+		}
+
+		std::size_t read(std::vector<edvs_event_t>& events)
+		{
+			events.resize(events_.size());
+			events.resize(read(events.data(), events.size()));
+			return events.size();
 		}
 
+		std::size_t read_wait(std::vector<edvs_event_t>& events, std::size_t min_events, std::chrono::microseconds timeout)
+		{
+			if(!is_open()) {
+				events.clear();
+				return 0;
+			}
+			min_events = std::min(min_events, events_.capacity());
+			notifier_->wait_until(std::chrono::steady_clock::now() + timeout,
+				[this, min_events]() {
+					return events_.size() >= min_events || is_finished_ || !is_running_;
+				});
+			return read(events);
+		}
+
+		std::size_t read_until(std::vector<edvs_event_t>& events, uint64_t time, std::chrono::microseconds timeout)
+		{
+			if(!is_open()) {
+				events.clear();
+				return 0;
+			}
+			notifier_->wait_until(std::chrono::steady_clock::now() + timeout,
+				[this, time]() {
+					return last_captured_time_ >= time || is_finished_ || !is_running_;
+				});
+			events.resize(events_.size());
+			events.resize(events_.pop_before(time, events.data(), events.size()));
+			if(!events.empty()) {
+				last_time_ = events.back().t;
+			}
+			return events.size();
+		}
+
+		bool seek(uint64_t time)
+		{
+			if(!is_open() || is_live()) {
+				return false;
+			}
+			// the capture thread must not read while the file position changes
+			const bool was_running = is_running_;
+			stop();
+			events_.clear();
+			const bool ok = (edvs_file_seek(h, time) == 0);
+			last_time_ = 0;
+			last_captured_time_ = 0;
+			if(was_running) {
+				is_running_ = true;
+				is_finished_ = false;
+				thread_ = std::thread(&SingleEventStream::runImpl, this);
+			}
+			return ok;
+		}
+
+		uint64_t num_dropped() const
+		{ return events_.num_dropped(); }
+
+		MergeStatistics merge_statistics() const
+		{ return MergeStatistics(); }
+
+		/** Timestamp of the last event delivered by the capture thread */
+		uint64_t last_captured_timestamp() const
+		{ return last_captured_time_; }
+
 		uint64_t last_timestamp() const
 		{ return last_time_; }
 
@@ -107,55 +321,154 @@ namespace Edvs
 		}
 
 	private:
-		std::vector<edvs_event_t> pop_events()
+		/** Pushes events into the ring buffer and waits for room if necessary
+		 * The capture time is published only for events which are in the buffer,
+		 * so that read_until does not return before events older than its time arrived.
+		 */
+		void push_events(const edvs_event_t* begin, std::size_t n)
 		{
-			std::lock_guard<std::mutex> lock(mtx_);
-			std::vector<edvs_event_t> tmp = std::move(events_); // TODO is this move correct?
-			events_ = {};
-			return tmp;
+			while(true) {
+				std::size_t m = events_.push(begin, n);
+				if(m > 0) {
+					last_captured_time_ = begin[m-1].t;
+				}
+				begin += m;
+				n -= m;
+				notifier_->notify();
+				if(n == 0 || !is_running_) {
+					break;
+				}
+				// buffer is full and the overflow policy is to block
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
 		}
-		
+
 		void runImpl()
 		{
-			std::vector<edvs_event_t> v;
+			PinCurrentThread(capture_cpu_);
+			const std::size_t num_max = 1024;
+			edvs_event_t buffer[num_max];
 			while(is_running_ && !edvs_eos(h)) {
-				v.resize(1024);
-				ssize_t m = edvs_read_ext(h, v.data(), v.size(), 0, 0);
-				if(m >= 0) {
-					v.resize(m);
+				ssize_t m = edvs_read_ext(h, buffer, num_max, 0, 0);
+				if(m > 0) {
+					push_events(buffer, m);
 				}
-				else {
-					v.clear();
-				}
-				std::lock_guard<std::mutex> lock(mtx_);
-				events_.insert(events_.end(), v.begin(), v.end());
 			}
+			is_finished_ = true;
+			notifier_->notify();
 		}
 		
 	private:
-		bool is_running_;
+		std::atomic<bool> is_running_;
+		std::atomic<bool> is_finished_;
 		std::thread thread_;
-		mutable std::mutex mtx_;
-		std::vector<edvs_event_t> events_;
+		EventRingBuffer events_;
+		std::shared_ptr<EventNotifier> notifier_;
+		int capture_cpu_;
 		edvs_stream_handle h;
 		uint64_t last_time_;
+		std::atomic<uint64_t> last_captured_time_;
 	};
 
 
+	/** Reads from many device streams in a single thread using epoll
+	 * Streams have to be started with SingleEventStream::run_polled.
+	 */
+	class EpollReader
+	{
+	public:
+		EpollReader(int cpu=-1)
+		: epfd_(epoll_create1(0)), cpu_(cpu), is_running_(false)
+		{}
+
+		EpollReader(const EpollReader&) = delete;
+		EpollReader& operator=(const EpollReader&) = delete;
+
+		~EpollReader()
+		{
+			stop();
+			if(epfd_ >= 0) {
+				::close(epfd_);
+			}
+		}
+
+		/** Registers a device stream, returns false if not possible */
+		bool add(SingleEventStream* s)
+		{
+			if(epfd_ < 0 || s->fd() < 0) {
+				return false;
+			}
+			epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.ptr = s;
+			return epoll_ctl(epfd_, EPOLL_CTL_ADD, s->fd(), &ev) == 0;
+		}
+
+		void start()
+		{
+			is_running_ = true;
+			thread_ = std::thread(&EpollReader::runImpl, this);
+		}
+
+		void stop()
+		{
+			if(is_running_) {
+				is_running_ = false;
+				thread_.join();
+			}
+		}
+
+	private:
+		void runImpl()
+		{
+			PinCurrentThread(cpu_);
+			const int num_max = 64;
+			epoll_event ready[num_max];
+			while(is_running_) {
+				// wake up regularly to check if we should stop
+				const int n = epoll_wait(epfd_, ready, num_max, 100);
+				for(int i=0; i<n; i++) {
+					SingleEventStream* s = static_cast<SingleEventStream*>(ready[i].data.ptr);
+					if(!s->poll()) {
+						epoll_ctl(epfd_, EPOLL_CTL_DEL, s->fd(), 0);
+					}
+				}
+			}
+		}
+
+	private:
+		int epfd_;
+		int cpu_;
+		std::atomic<bool> is_running_;
+		std::thread thread_;
+	};
+
+	/** Number of events per stream which are read at once for merging */
+	const std::size_t cMergeQueueCapacity = 4096;
+
 	class MultiEventStream : public IEventStream
 	{
 	public:
-		MultiEventStream() {}
+		MultiEventStream(const EventStreamParameters& params=EventStreamParameters())
+		: params_(params), notifier_(std::make_shared<EventNotifier>()),
+		  common_time_(0), released_time_(0)
+		{}
 		
 		MultiEventStream(const MultiEventStream&) = delete;
 		MultiEventStream& operator=(const MultiEventStream&) = delete;
 		
-		MultiEventStream(const std::vector<std::string>& uris)
+		MultiEventStream(const std::vector<std::string>& uris, const EventStreamParameters& params=EventStreamParameters())
+		: MultiEventStream(params)
 		{
 			open(uris);
 			run();
 		}
 
+		~MultiEventStream()
+		{
+			close();
+		}
+
 		unsigned num_streams() const
 		{
 			return streams_.size();
@@ -164,23 +477,32 @@ namespace Edvs
 		void open(const std::vector<std::string>& uris)
 		{
 			for(const std::string& uri : uris) {
-				SingleEventStream* ses = new SingleEventStream();
+				SingleEventStream* ses = new SingleEventStream(params_);
+				ses->set_notifier(notifier_);
 				ses->open(uri);
 				streams_.emplace_back(ses);
+				queues_.emplace_back();
+				queues_.back().events.resize(cMergeQueueCapacity);
 			}
 		}
 
 		void run()
 		{
+			if(params_.shared_io_thread) {
+				io_.reset(new EpollReader(params_.capture_cpu));
+			}
 			// master first
 			for(auto& s : streams_) {
 				if(s->is_master())
-					s->run();
+					run(s.get());
 			}
 			// then slaves
 			for(auto& s : streams_) {
 				if(s->is_slave())
-					s->run();
+					run(s.get());
+			}
+			if(io_) {
+				io_->start();
 			}
 		}
 
@@ -203,17 +525,14 @@ namespace Edvs
 			if(streams_.size() == 0) {
 				return true;
 			}
-			// still events in queue => not eos
-			if(!events_.empty()) {
-				return false;
-			}
-			// check if any stream is eos
-			for(const auto& s : streams_) {
-				if(s->eos()) {
-					return true;
+			// eos only if all streams are finished with empty ring buffers
+			// and all their events have left the merge queues
+			for(std::size_t i=0; i<streams_.size(); i++) {
+				if(!queues_[i].empty() || !streams_[i]->eos()) {
+					return false;
 				}
 			}
-			return false;
+			return true;
 		}
 
 		bool is_live() const
@@ -231,84 +550,317 @@ namespace Edvs
 
 		void close()
 		{
+			// stop all streams first so that the I/O thread can not block on a full buffer
+			for(const auto& s : streams_) {
+				s->stop();
+			}
+			if(io_) {
+				io_->stop();
+			}
 			for(const auto& s : streams_) {
 				s->close();
 			}
 		}
 
-		std::vector<edvs_event_t> read()
+		using IEventStream::read;
+		using IEventStream::read_wait;
+		using IEventStream::read_until;
+
+		std::size_t read(edvs_event_t* events, std::size_t capacity)
+		{
+			return merge(events, capacity, std::numeric_limits<uint64_t>::max());
+		}
+
+		std::size_t read(std::vector<edvs_event_t>& events)
+		{
+			events.clear();
+			append(events, std::numeric_limits<uint64_t>::max());
+			return events.size();
+		}
+
+		std::size_t read_wait(std::vector<edvs_event_t>& events, std::size_t min_events, std::chrono::microseconds timeout)
+		{
+			const auto deadline = std::chrono::steady_clock::now() + timeout;
+			events.clear();
+			while(true) {
+				const uint64_t generation = notifier_->generation();
+				append(events, std::numeric_limits<uint64_t>::max());
+				if(events.size() >= min_events || eos()) {
+					break;
+				}
+				// wait until any stream delivers new events
+				if(!notifier_->wait_until(deadline,
+						[this, generation]() { return notifier_->generation() != generation; })) {
+					break;
+				}
+			}
+			return events.size();
+		}
+
+		std::size_t read_until(std::vector<edvs_event_t>& events, uint64_t time, std::chrono::microseconds timeout)
+		{
+			const auto deadline = std::chrono::steady_clock::now() + timeout;
+			events.clear();
+			while(true) {
+				const uint64_t generation = notifier_->generation();
+				append(events, time);
+				if(common_time_ >= time || eos()) {
+					break;
+				}
+				if(!notifier_->wait_until(deadline,
+						[this, generation]() { return notifier_->generation() != generation; })) {
+					break;
+				}
+			}
+			return events.size();
+		}
+
+		bool seek(uint64_t time)
+		{
+			if(streams_.empty() || is_live()) {
+				return false;
+			}
+			bool ok = true;
+			for(std::size_t i=0; i<streams_.size(); i++) {
+				ok = streams_[i]->seek(time) && ok;
+				queues_[i].begin = 0;
+				queues_[i].end = 0;
+				queues_[i].watermark = 0;
+			}
+			common_time_ = 0;
+			released_time_ = 0;
+			return ok;
+		}
+
+		uint64_t num_dropped() const
+		{
+			uint64_t n = 0;
+			for(const auto& s : streams_) {
+				n += s->num_dropped();
+			}
+			return n;
+		}
+
+		MergeStatistics merge_statistics() const
+		{ return statistics_; }
+
+		void write(const std::string& cmd) const
+		{
+			for(const auto& s : streams_) {
+				s->write(cmd);
+			}
+		}
+
+	private:
+		/** Events read from one stream which have not been merged yet */
+		struct StreamQueue
+		{
+			StreamQueue()
+			: begin(0), end(0), watermark(0),
+			  last_active(std::chrono::steady_clock::now()), is_quiet(false)
+			{}
+
+			bool empty() const
+			{ return begin == end; }
+
+			const edvs_event_t& front() const
+			{ return events[begin]; }
+
+			std::vector<edvs_event_t> events;
+			std::size_t begin, end;
+			uint64_t watermark;
+			std::chrono::steady_clock::time_point last_active;
+			bool is_quiet;
+		};
+
+		typedef std::pair<uint64_t,std::size_t> HeapItem;
+
+		/** Starts a stream with the shared I/O thread or with its own capture thread */
+		void run(SingleEventStream* s)
+		{
+			if(io_ && io_->add(s)) {
+				s->run_polled();
+			}
+			else {
+				s->run();
+			}
+		}
+
+		/** Moves events from the stream ring buffers into empty merge queues
+		 * Also updates the watermark of each stream and the common time.
+		 */
+		void refill()
 		{
+			const auto now = std::chrono::steady_clock::now();
+			for(std::size_t i=0; i<streams_.size(); i++) {
+				StreamQueue& q = queues_[i];
+				if(q.empty()) {
+					q.begin = 0;
+					q.end = streams_[i]->read(q.events.data(), q.events.size());
+					if(q.end > 0) {
+						q.last_active = now;
+						q.is_quiet = false;
+						handle_late_events(q);
+					}
+					// set correct ID
+					// we only do this for multiple streams
+					// FIXME need a mechanism to check if we need to do it ...
+					if(streams_.size() > 1) {
+						// id of stream is its position in the list of streams 
+						for(std::size_t j=q.begin; j<q.end; j++) {
+							q.events[j].id = i;
+						}
+					}
+				}
+				// events of a stream are ordered, so no event older than the
+				// last one we read from the stream will follow
+				q.watermark = streams_[i]->last_timestamp();
+			}
 			// compute the "common time"
 			// this is the time up to which all streams have delivered events
+			// streams which are finished or quiet for too long are not waited for
 			uint64_t common_time = std::numeric_limits<uint64_t>::max();
-			// id of stream is its position in the list of streams 
-			uint8_t id = 0;
-			// iterate over all streams and get events
-			bool all_empty = true;
-			for(const auto& s : streams_) {
-				// read maximum number of events from stream
-				auto tmp = s->read();
-				// update common time
-				uint64_t lastts = s->last_timestamp();
-				common_time = std::min(common_time, lastts);
-				// check if streams return nothing
-				all_empty = all_empty && tmp.empty();
-				// set correct ID
-				// we only do this for multiple streams
-				// FIXME need a mechanism to check if we need to do it ...
-				if(streams_.size() > 1) {
-					for(auto& e : tmp) {
-						e.id = id;
-	//					std::cout << (int)(e.id) << " " << e.t << std::endl;
+			uint64_t max_watermark = 0;
+			bool any_waiting = false;
+			for(std::size_t i=0; i<streams_.size(); i++) {
+				StreamQueue& q = queues_[i];
+				max_watermark = std::max(max_watermark, q.watermark);
+				if(q.empty() && streams_[i]->eos()) {
+					continue;
+				}
+				if(q.empty() && params_.max_merge_latency.count() > 0
+						&& now - q.last_active > params_.max_merge_latency) {
+					if(!q.is_quiet) {
+						q.is_quiet = true;
+						statistics_.num_watermark_advances++;
 					}
+					continue;
 				}
-				// add events to our buffer
-				events_.insert(events_.end(), tmp.begin(), tmp.end());
-				// next stream gets next id
-				id ++;
-			}
-			if(all_empty) {
-				return {};
-			}
-			// sort our buffer by timestamps
-			std::sort(events_.begin(), events_.end(),
-				[](const edvs_event_t& a, const edvs_event_t& b) {
-					return a.t < b.t;
-				});
-			// find location of common time in our buffer
-			auto it = std::upper_bound(events_.begin(), events_.end(), common_time,
-				[](uint64_t t, const edvs_event_t& e) { return t < e.t; });
-			// remove the corresponding chunk of events from our buffer and return them
-			std::vector<edvs_event_t> ret(events_.begin(), it);
-			events_.erase(events_.begin(), it);
-			return ret;
+				common_time = std::min(common_time, q.watermark);
+				any_waiting = true;
+			}
+			// if no stream is waited for all queued events can be released
+			common_time_ = any_waiting ? common_time : max_watermark;
 		}
 
-		void write(const std::string& cmd) const
+		/** Drops or counts events in a freshly filled queue which are older than already released events */
+		void handle_late_events(StreamQueue& q)
 		{
-			for(const auto& s : streams_) {
-				s->write(cmd);
+			if(q.front().t >= released_time_) {
+				return;
+			}
+			auto it = std::lower_bound(q.events.begin() + q.begin, q.events.begin() + q.end, released_time_,
+				[](const edvs_event_t& e, uint64_t t) { return e.t < t; });
+			const std::size_t num_late = std::distance(q.events.begin() + q.begin, it);
+			if(params_.late_event_policy == LateEventPolicy::Drop) {
+				statistics_.num_late_dropped += num_late;
+				q.begin += num_late;
+			}
+			else {
+				statistics_.num_late_emitted += num_late;
+			}
+		}
+
+		/** Merges queued events with timestamp smaller than 'time' in timestamp order
+		 * Only events up to the common time are merged because a stream with
+		 * an older watermark could still deliver earlier events. Each stream is
+		 * already ordered, so this is a k-way merge using a heap of queue heads.
+		 * @return number of events written to 'events'
+		 */
+		std::size_t merge(edvs_event_t* events, std::size_t capacity, uint64_t time)
+		{
+			std::size_t num = 0;
+			while(num < capacity) {
+				refill();
+				// only release events with timestamp <= common time and < time
+				const uint64_t limit = (time == 0) ? 0 : std::min(common_time_, time - 1);
+				heap_.clear();
+				for(std::size_t i=0; i<queues_.size(); i++) {
+					if(!queues_[i].empty()) {
+						heap_.push_back(std::make_pair(queues_[i].front().t, i));
+					}
+				}
+				std::make_heap(heap_.begin(), heap_.end(), std::greater<HeapItem>());
+				const std::size_t num_before = num;
+				// the heap top is the earliest head, so nothing else can be released after it passed the limit
+				while(!heap_.empty() && num < capacity && heap_.front().first <= limit) {
+					std::pop_heap(heap_.begin(), heap_.end(), std::greater<HeapItem>());
+					const std::size_t i = heap_.back().second;
+					heap_.pop_back();
+					// take all events of this queue which are not later than the next queue
+					const uint64_t run_limit = heap_.empty() ? limit : std::min(limit, heap_.front().first);
+					StreamQueue& q = queues_[i];
+					while(!q.empty() && num < capacity && q.front().t <= run_limit) {
+						events[num++] = q.front();
+						q.begin++;
+					}
+					if(num > 0) {
+						released_time_ = std::max(released_time_, events[num-1].t);
+					}
+					// a queue blocked by the limit leaves the heap, other queues may still be released
+					if(!q.empty() && q.front().t <= limit) {
+						heap_.push_back(std::make_pair(q.front().t, i));
+						std::push_heap(heap_.begin(), heap_.end(), std::greater<HeapItem>());
+					}
+				}
+				// continue as long as emptied queues could be refilled
+				if(num == num_before || !any_queue_empty()) {
+					break;
+				}
+			}
+			return num;
+		}
+
+		bool any_queue_empty() const
+		{
+			for(const auto& q : queues_) {
+				if(q.empty()) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/** Merges events with timestamp smaller than 'time' and appends them to 'events' */
+		void append(std::vector<edvs_event_t>& events, uint64_t time)
+		{
+			while(true) {
+				const std::size_t offset = events.size();
+				const std::size_t n = std::max<std::size_t>(events.capacity() - offset, cMergeQueueCapacity);
+				events.resize(offset + n);
+				const std::size_t m = merge(events.data() + offset, n, time);
+				events.resize(offset + m);
+				if(m < n) {
+					break;
+				}
 			}
 		}
 
 	private:
+		EventStreamParameters params_;
+		std::shared_ptr<EventNotifier> notifier_;
 		std::vector<std::unique_ptr<SingleEventStream>> streams_;
-		std::vector<edvs_event_t> events_;
+		std::unique_ptr<EpollReader> io_;
+		std::vector<StreamQueue> queues_;
+		std::vector<HeapItem> heap_;
+		uint64_t common_time_;
+		uint64_t released_time_;
+		MergeStatistics statistics_;
 	};
 
-	std::shared_ptr<IEventStream> OpenEventStream(const std::string& uri)
+	std::shared_ptr<IEventStream> OpenEventStream(const std::string& uri, const EventStreamParameters& params)
 	{
-		return std::make_shared<SingleEventStream>(uri);
+		return std::make_shared<SingleEventStream>(uri, params);
 	}
 
-	std::shared_ptr<IEventStream> OpenEventStream(const std::initializer_list<std::string>& uris)
+	std::shared_ptr<IEventStream> OpenEventStream(const std::initializer_list<std::string>& uris, const EventStreamParameters& params)
 	{
-		return std::make_shared<MultiEventStream>(uris);
+		return std::make_shared<MultiEventStream>(uris, params);
 	}
 
-	std::shared_ptr<IEventStream> OpenEventStream(const std::vector<std::string>& uris)
+	std::shared_ptr<IEventStream> OpenEventStream(const std::vector<std::string>& uris, const EventStreamParameters& params)
 	{
-		return std::make_shared<MultiEventStream>(uris);
+		return std::make_shared<MultiEventStream>(uris, params);
 	}
 
 }
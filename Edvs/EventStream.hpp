@@ -2,14 +2,81 @@
 #define INCLUDE_EDVS_EVENTSTREAM_HPP
 
 #include "Event.hpp"
+#include "EventRingBuffer.hpp"
 #include <vector>
 #include <string>
 #include <memory>
+#include <chrono>
 #include <initializer_list>
 
 namespace Edvs
 {
 
+	/** Determines what happens with events of a stream which arrive after
+	 * newer events of other streams have already been returned
+	 */
+	enum class LateEventPolicy
+	{
+		Drop, // discard late events
+		Emit // return late events, i.e. out of timestamp order
+	};
+
+	/** Parameters used when opening event streams */
+	struct EventStreamParameters
+	{
+		EventStreamParameters()
+		: buffer_capacity(1<<20), overflow_policy(OverflowPolicy::Block),
+		  max_merge_latency(0), late_event_policy(LateEventPolicy::Drop),
+		  shared_io_thread(false), capture_cpu(-1)
+		{}
+
+		/** Maximum number of events buffered per stream between capture thread and reader */
+		std::size_t buffer_capacity;
+
+		/** What happens if the reader does not keep up with the capture thread */
+		OverflowPolicy overflow_policy;
+
+		/** Maximum time a quiet stream may hold back the merged output of multiple streams
+		 * Multiple streams are merged in timestamp order, so normally events are
+		 * only returned once every stream has delivered newer events. A stream
+		 * which delivers no events for longer than this (host clock) is ignored
+		 * until it delivers again. Zero disables this and waits indefinitely.
+		 */
+		std::chrono::microseconds max_merge_latency;
+
+		/** What happens with events of a stream which was ignored as quiet */
+		LateEventPolicy late_event_policy;
+
+		/** Read all device streams of a multi stream in a single I/O thread
+		 * Serial ports and network sockets are multiplexed with epoll instead of
+		 * using one capture thread per device. File streams keep their own thread.
+		 * With OverflowPolicy::Block a full buffer stalls all devices.
+		 */
+		bool shared_io_thread;
+
+		/** Pins capture threads and the shared I/O thread to this CPU (-1 for no pinning)
+		 * Keeps device reads on one core, away from processing or disk writes.
+		 */
+		int capture_cpu;
+	};
+
+	/** Counters describing how multiple streams were merged */
+	struct MergeStatistics
+	{
+		MergeStatistics()
+		: num_watermark_advances(0), num_late_dropped(0), num_late_emitted(0)
+		{}
+
+		/** Number of times a quiet stream was ignored to let the others continue */
+		uint64_t num_watermark_advances;
+
+		/** Number of late events which were discarded */
+		uint64_t num_late_dropped;
+
+		/** Number of late events which were returned out of order */
+		uint64_t num_late_emitted;
+	};
+
 	class IEventStream
 	{
 	public:
@@ -17,17 +84,78 @@ namespace Edvs
 		virtual bool is_open() const = 0;
 		virtual bool eos() const = 0;
 		virtual bool is_live() const = 0;
-		virtual std::vector<edvs_event_t> read() = 0;
+
+		/** Reads up to 'capacity' available events into a caller-owned buffer
+		 * @return number of events written to 'events'
+		 */
+		virtual std::size_t read(edvs_event_t* events, std::size_t capacity) = 0;
+
+		/** Reads all available events into 'events'
+		 * The previous content of 'events' is replaced. Its memory is reused so
+		 * that repeated calls with the same vector do not allocate.
+		 * @return number of events read
+		 */
+		virtual std::size_t read(std::vector<edvs_event_t>& events) = 0;
+
+		/** Reads events and blocks until at least 'min_events' events are available
+		 * Returns early with less events if the timeout expires or the end of
+		 * the stream is reached.
+		 */
+		virtual std::size_t read_wait(std::vector<edvs_event_t>& events, std::size_t min_events, std::chrono::microseconds timeout) = 0;
+
+		/** Reads all events with timestamp smaller than 'time'
+		 * Blocks until the stream has reached 'time', the timeout expires or
+		 * the end of the stream is reached. Events with later timestamps stay
+		 * in the stream for the next read.
+		 */
+		virtual std::size_t read_until(std::vector<edvs_event_t>& events, uint64_t time, std::chrono::microseconds timeout) = 0;
+
+		std::vector<edvs_event_t> read()
+		{
+			std::vector<edvs_event_t> v;
+			read(v);
+			return v;
+		}
+
+		std::vector<edvs_event_t> read_wait(std::size_t min_events, std::chrono::microseconds timeout)
+		{
+			std::vector<edvs_event_t> v;
+			read_wait(v, min_events, timeout);
+			return v;
+		}
+
+		std::vector<edvs_event_t> read_until(uint64_t time, std::chrono::microseconds timeout)
+		{
+			std::vector<edvs_event_t> v;
+			read_until(v, time, timeout);
+			return v;
+		}
+
+		/** Moves a file stream to the first event with timestamp greater or equal to 'time'
+		 * Events which were not read yet are discarded. Uses the chunk index of
+		 * the event file, so the recording is not loaded.
+		 * @return false for live streams or on error
+		 */
+		virtual bool seek(uint64_t time) = 0;
+
+		/** Number of events discarded because a stream buffer was full */
+		virtual uint64_t num_dropped() const = 0;
+
+		/** Counters for merging multiple streams (all zero for a single stream) */
+		virtual MergeStatistics merge_statistics() const = 0;
 	};
 
 	std::shared_ptr<IEventStream> OpenEventStream(
-		const std::string& uri);
+		const std::string& uri,
+		const EventStreamParameters& params=EventStreamParameters());
 
 	std::shared_ptr<IEventStream> OpenEventStream(
-		const std::initializer_list<std::string>& uris);
+		const std::initializer_list<std::string>& uris,
+		const EventStreamParameters& params=EventStreamParameters());
 
 	std::shared_ptr<IEventStream> OpenEventStream(
-		const std::vector<std::string>& uris);
+		const std::vector<std::string>& uris,
+		const EventStreamParameters& params=EventStreamParameters());
 
 }
 
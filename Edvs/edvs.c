@@ -245,9 +245,353 @@ void sleep_ms(unsigned long long milli_secs)
 	nanosleep(&ts, NULL);
 }
 
+// ----- ----- ----- ----- ----- ----- ----- ----- ----- //
+
+#include <sys/mman.h>
+
+int edvs_byte_ring_init(edvs_byte_ring_t* r, size_t length)
+{
+	// round up to page size (required for the double mapping)
+	const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	length = ((length + page - 1) / page) * page;
+	r->length = length;
+	r->begin = 0;
+	r->end = 0;
+	r->is_mirrored = 0;
+	// try to map the same memory twice back to back
+	int fd = memfd_create("edvs_byte_ring", 0);
+	if(fd >= 0) {
+		unsigned char* p = 0;
+		if(ftruncate(fd, length) == 0) {
+			// reserve address space for both mappings
+			p = (unsigned char*)mmap(NULL, 2*length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if(p == MAP_FAILED) {
+				p = 0;
+			}
+			else if(mmap(p, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+				|| mmap(p + length, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+				munmap(p, 2*length);
+				p = 0;
+			}
+		}
+		close(fd);
+		if(p != 0) {
+			r->data = p;
+			r->is_mirrored = 1;
+			return 0;
+		}
+	}
+#ifdef EDVS_LOG_MESSAGE
+	printf("edvs_byte_ring_init: double mapping not available, using a linear buffer\n");
+#endif
+	// fallback: linear buffer which is compacted when necessary
+	r->data = (unsigned char*)malloc(length);
+	if(r->data == 0) {
+		return -1;
+	}
+	return 0;
+}
+
+void edvs_byte_ring_free(edvs_byte_ring_t* r)
+{
+	if(r->is_mirrored) {
+		munmap(r->data, 2*r->length);
+	}
+	else {
+		free(r->data);
+	}
+	r->data = 0;
+}
+
+size_t edvs_byte_ring_size(const edvs_byte_ring_t* r)
+{
+	return r->end - r->begin;
+}
+
+unsigned char* edvs_byte_ring_write_ptr(edvs_byte_ring_t* r, size_t* n)
+{
+	const size_t size = r->end - r->begin;
+	if(!r->is_mirrored && r->begin > 0) {
+		// move the (usually very short) unparsed rest to the front
+		memmove(r->data, r->data + r->begin, size);
+		r->begin = 0;
+		r->end = size;
+	}
+	*n = r->length - size;
+	return r->data + (r->end % r->length);
+}
+
+const unsigned char* edvs_byte_ring_read_ptr(const edvs_byte_ring_t* r, size_t* n)
+{
+	*n = r->end - r->begin;
+	return r->data + (r->begin % r->length);
+}
+
+void edvs_byte_ring_consume(edvs_byte_ring_t* r, size_t n)
+{
+	r->begin += n;
+}
+
+// ----- ----- ----- ----- ----- ----- ----- ----- ----- //
+
+// ----- ----- ----- ----- ----- ----- ----- ----- ----- //
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define EDVS_HAVE_IO_URING
+#endif
+#endif
+
+#ifdef EDVS_HAVE_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+
+/** Minimal io_uring without liburing
+ * Keeps at most one read in flight. The destination buffer is registered
+ * with the kernel if possible (IORING_OP_READ_FIXED).
+ */
+struct edvs_uring_t {
+	int ring_fd;
+	int fd;
+	int is_fixed;
+	int is_pending;
+	void* sq_ptr;
+	size_t sq_size;
+	void* cq_ptr;
+	size_t cq_size;
+	struct io_uring_sqe* sqes;
+	size_t sqes_size;
+	unsigned* sq_tail;
+	unsigned* sq_mask;
+	unsigned* sq_array;
+	unsigned* cq_head;
+	unsigned* cq_tail;
+	unsigned* cq_mask;
+	struct io_uring_cqe* cqes;
+};
+
+/** user_data of the read and of its cancellation */
+const uint64_t cUringReadTag = 1;
+const uint64_t cUringCancelTag = 2;
+
+struct edvs_uring_t* edvs_uring_open(int fd, void* buffer, size_t length)
+{
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	int ring_fd = syscall(__NR_io_uring_setup, 4, &p);
+	if(ring_fd < 0) {
+		printf("edvs_uring_open: io_uring_setup error %d\n", errno);
+		return 0;
+	}
+	struct edvs_uring_t* u = (struct edvs_uring_t*)malloc(sizeof(struct edvs_uring_t));
+	memset(u, 0, sizeof(struct edvs_uring_t));
+	u->ring_fd = ring_fd;
+	u->fd = fd;
+	// map submission and completion queues
+	u->sq_size = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+	u->cq_size = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+	u->sqes_size = p.sq_entries*sizeof(struct io_uring_sqe);
+	u->sq_ptr = mmap(0, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+	u->cq_ptr = mmap(0, u->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+	u->sqes = (struct io_uring_sqe*)mmap(0, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+	if(u->sq_ptr == MAP_FAILED || u->cq_ptr == MAP_FAILED || u->sqes == MAP_FAILED) {
+		printf("edvs_uring_open: mmap error %d\n", errno);
+		if(u->sq_ptr != MAP_FAILED) munmap(u->sq_ptr, u->sq_size);
+		if(u->cq_ptr != MAP_FAILED) munmap(u->cq_ptr, u->cq_size);
+		if(u->sqes != MAP_FAILED) munmap(u->sqes, u->sqes_size);
+		close(ring_fd);
+		free(u);
+		return 0;
+	}
+	unsigned char* sq = (unsigned char*)u->sq_ptr;
+	unsigned char* cq = (unsigned char*)u->cq_ptr;
+	u->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+	u->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+	u->sq_array = (unsigned*)(sq + p.sq_off.array);
+	u->cq_head = (unsigned*)(cq + p.cq_off.head);
+	u->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+	u->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+	// register the destination buffer to avoid mapping it for each read
+	struct iovec iov;
+	iov.iov_base = buffer;
+	iov.iov_len = length;
+	u->is_fixed = (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0);
+#ifdef EDVS_LOG_VERBOSE
+	if(!u->is_fixed) {
+		printf("edvs_uring_open: could not register buffer (error %d), using normal reads\n", errno);
+	}
+#endif
+	return u;
+}
+
+/** Cancels the pending read and waits until the kernel is done with it
+ * Closing the ring only starts an asynchronous teardown. A read which is
+ * already running could still write into the buffer after it was freed.
+ */
+void edvs_uring_cancel_read(struct edvs_uring_t* u)
+{
+	if(!u->is_pending) {
+		return;
+	}
+	const unsigned tail = *u->sq_tail;
+	const unsigned index = tail & *u->sq_mask;
+	struct io_uring_sqe* sqe = u->sqes + index;
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = cUringReadTag;
+	sqe->user_data = cUringCancelTag;
+	u->sq_array[index] = index;
+	__atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	// the read completes either with its data or as cancelled
+	unsigned num_submit = 1;
+	int is_read_done = 0;
+	int is_cancel_done = 0;
+	while(1) {
+		unsigned head = *u->cq_head;
+		while(head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+			const uint64_t tag = u->cqes[head & *u->cq_mask].user_data;
+			is_read_done |= (tag == cUringReadTag);
+			is_cancel_done |= (tag == cUringCancelTag);
+			head++;
+		}
+		__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+		if(is_read_done && is_cancel_done) {
+			break;
+		}
+		const int r = syscall(__NR_io_uring_enter, u->ring_fd, num_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		if(r < 0 && errno != EINTR) {
+			printf("edvs_uring_cancel_read: io_uring_enter error %d\n", errno);
+			break;
+		}
+		if(r >= 0) {
+			num_submit = 0;
+		}
+	}
+	u->is_pending = 0;
+}
+
+void edvs_uring_close(struct edvs_uring_t* u)
+{
+	// the read buffer is freed after this, so no read may be in flight
+	edvs_uring_cancel_read(u);
+	munmap(u->sqes, u->sqes_size);
+	munmap(u->cq_ptr, u->cq_size);
+	munmap(u->sq_ptr, u->sq_size);
+	close(u->ring_fd);
+	free(u);
+}
+
+/** Queues and submits a read of at most 'n' bytes into 'dst' */
+int edvs_uring_submit_read(struct edvs_uring_t* u, unsigned char* dst, size_t n)
+{
+	const unsigned tail = *u->sq_tail;
+	const unsigned index = tail & *u->sq_mask;
+	struct io_uring_sqe* sqe = u->sqes + index;
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = u->is_fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+	sqe->fd = u->fd;
+	sqe->addr = (uintptr_t)dst;
+	sqe->len = (n > 0x7FFFFFFF) ? 0x7FFFFFFF : n;
+	sqe->off = (uint64_t)-1; // serial ports and sockets are not seekable
+	sqe->buf_index = 0;
+	sqe->user_data = cUringReadTag;
+	u->sq_array[index] = index;
+	__atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	if(syscall(__NR_io_uring_enter, u->ring_fd, 1, 0, 0, NULL, 0) != 1) {
+		printf("edvs_uring_submit_read: io_uring_enter error %d\n", errno);
+		return -1;
+	}
+	u->is_pending = 1;
+	return 0;
+}
+
+/** Waits for the pending read
+ * @return number of bytes read or -1 on error
+ */
+ssize_t edvs_uring_wait_read(struct edvs_uring_t* u)
+{
+	unsigned head = *u->cq_head;
+	while(head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+		// nothing completed yet => block in the kernel
+		if(syscall(__NR_io_uring_enter, u->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) {
+			printf("edvs_uring_wait_read: io_uring_enter error %d\n", errno);
+			return -1;
+		}
+	}
+	const int res = u->cqes[head & *u->cq_mask].res;
+	__atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+	u->is_pending = 0;
+	if(res < 0) {
+		printf("edvs_uring_wait_read: read error %d\n", -res);
+		return -1;
+	}
+	return res;
+}
+
+int edvs_uring_get_fd(struct edvs_uring_t* u)
+{
+	return u->ring_fd;
+}
+
+int edvs_uring_is_pending(struct edvs_uring_t* u)
+{
+	return u->is_pending;
+}
+
+#else
+
+struct edvs_uring_t* edvs_uring_open(int fd, void* buffer, size_t length)
+{
+	printf("edvs_uring_open: io_uring is not available on this platform\n");
+	return 0;
+}
+
+void edvs_uring_close(struct edvs_uring_t* u) {}
+
+int edvs_uring_submit_read(struct edvs_uring_t* u, unsigned char* dst, size_t n)
+{
+	return -1;
+}
+
+ssize_t edvs_uring_wait_read(struct edvs_uring_t* u)
+{
+	return -1;
+}
+
+int edvs_uring_get_fd(struct edvs_uring_t* u)
+{
+	return -1;
+}
+
+int edvs_uring_is_pending(struct edvs_uring_t* u)
+{
+	return 0;
+}
+
+#endif
+
+/** Submits a read into the free part of the buffer unless one is pending or the buffer is full */
+int edvs_device_streaming_submit_uring(edvs_device_streaming_t* s)
+{
+	if(edvs_uring_is_pending(s->uring)) {
+		return 0;
+	}
+	size_t num_free;
+	unsigned char* dst = edvs_byte_ring_write_ptr(&s->ring, &num_free);
+	if(num_free == 0) {
+		return 0;
+	}
+	return edvs_uring_submit_read(s->uring, dst, num_free);
+}
+
+// ----- ----- ----- ----- ----- ----- ----- ----- ----- //
+
 uint64_t c_uint64_t_max = 0xFFFFFFFFFFFFFFFFL;
 
-edvs_device_streaming_t* edvs_device_streaming_open(edvs_device_t* dh, int device_tsm, int host_tsm, int master_slave_mode)
+edvs_device_streaming_t* edvs_device_streaming_open(edvs_device_t* dh, int device_tsm, int host_tsm, int master_slave_mode, size_t buffer_size, int io_mode)
 {
 	edvs_device_streaming_t *s = (edvs_device_streaming_t*)malloc(sizeof(edvs_device_streaming_t));
 	if(s == 0) {
@@ -257,9 +601,20 @@ edvs_device_streaming_t* edvs_device_streaming_open(edvs_device_t* dh, int devic
 	s->device_timestamp_mode = device_tsm;
 	s->host_timestamp_mode = host_tsm;
 	s->master_slave_mode = master_slave_mode;
-	s->length = 8192;
-	s->buffer = (unsigned char*)malloc(s->length);
-	s->offset = 0;
+	if(edvs_byte_ring_init(&s->ring, buffer_size) != 0) {
+		free(s);
+		return 0;
+	}
+	s->uring = 0;
+	if(io_mode == 1) {
+		// a read is pending while events are parsed, so the buffer must never be compacted
+		if(s->ring.is_mirrored) {
+			s->uring = edvs_uring_open(dh->handle, s->ring.data, 2*s->ring.length);
+		}
+		if(s->uring == 0) {
+			printf("edvs_device_streaming_open: io_uring not available, using normal reads\n");
+		}
+	}
 //	s->current_time = 0;
 //	s->last_timestamp = timestamp_limit(s->device_timestamp_mode);
 	s->ts_last_device = c_uint64_t_max;
@@ -391,6 +746,11 @@ int edvs_device_streaming_run(edvs_device_streaming_t* s)
 		return -1;
 	// wait until we get E+\n back
 	wait_for(s, "E+\n");
+	// from now on a read is pending whenever there is room in the buffer
+	if(s->uring) {
+		if(edvs_device_streaming_submit_uring(s) != 0)
+			return -1;
+	}
 	return 0;
 }
 
@@ -481,302 +841,1662 @@ void compute_timestamps_systime(edvs_event_t* begin, size_t n, uint64_t last_dev
 	begin->t = next_set_host; // set last here due to delayed set
 }
 
-ssize_t edvs_device_streaming_read(edvs_device_streaming_t* s, edvs_event_t* events, size_t n, edvs_special_t* special, size_t* ns)
+// ----- ----- ----- ----- ----- ----- ----- ----- ----- //
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define EDVS_ALWAYS_INLINE static inline __attribute__((always_inline))
+
+const unsigned char cHighBitMask = 0x80; // 10000000
+const unsigned char cLowerBitsMask = 0x7F; // 01111111
+
+/** Number of bytes used by the device for one timestamp */
+unsigned int timestamp_num_bytes(int device_tsm)
 {
-	// realtime timer
-	uint64_t system_clock_time = 0;
-	if(s->host_timestamp_mode == 2) {
-		system_clock_time = get_micro_time();
+	return (device_tsm == 0) ? 0 : (device_tsm + 1);
+}
+
+/** Parses a single event or special data block (careful path)
+ * Checks for errors in the high bit and for special data.
+ * @return number of bytes consumed
+ */
+size_t parse_careful(const unsigned char* buffer, int device_tsm, int with_special,
+	edvs_event_t** event_it, edvs_special_t** special_it)
+{
+	const int timestamp_mode = (device_tsm > 3) ? 0 : device_tsm;
+	const unsigned int cNumBytesTimestamp = timestamp_num_bytes(device_tsm);
+	size_t i = 0;
+	// get two bytes
+	unsigned char a = buffer[i];
+	unsigned char b = buffer[i + 1];
 #ifdef EDVS_LOG_ULTRA
-		printf("Time: %ld\n", system_clock_time);
+//	printf("e: %d %d\n", a, b);
 #endif
+	i += 2;
+	// check for and parse 1yyyyyyy pxxxxxxx
+	if((a & cHighBitMask) == 0) { // check that the high bit of first byte is 1
+		// the serial port missed a byte somewhere ...
+		// skip one byte to jump to the next event
+		printf("Error in high bit! Skipping a byte\n");
+		return 1;
 	}
-	// constants
-	const int timestamp_mode = (s->device_timestamp_mode > 3) ? 0 : s->device_timestamp_mode;
-	const unsigned char cHighBitMask = 0x80; // 10000000
-	const unsigned char cLowerBitsMask = 0x7F; // 01111111
-	const unsigned int cNumBytesTimestamp = (s->device_timestamp_mode == 0) ? 0 : (s->device_timestamp_mode + 1);
-	const uint64_t cTimestampLimit = timestamp_limit(timestamp_mode);
+	// check for special data
+	size_t special_data_len = 0;
+	if(with_special && a == 0 && b == 0) {
+		// get special data length
+		special_data_len = (buffer[i] & 0x0F);
+		// HACK assuming special data always sends timestamp!
+		if(special_data_len >= cNumBytesTimestamp) {
+			special_data_len -= cNumBytesTimestamp;
+		}
+		else {
+			printf("ERROR parsing special data length!\n");
+		}
+		i ++;
+#ifdef EDVS_LOG_ULTRA
+//		printf("s: len=%ld\n", special_data_len);
+#endif
+	}
+	// read timestamp
+	uint64_t timestamp;
+	if(timestamp_mode == 1) {
+		timestamp =
+			  ((uint64_t)(buffer[i  ]) <<  8)
+			|  (uint64_t)(buffer[i+1]);
+	}
+	else if(timestamp_mode == 2) {
+		timestamp =
+			  ((uint64_t)(buffer[i  ]) << 16)
+			| ((uint64_t)(buffer[i+1]) <<  8)
+			|  (uint64_t)(buffer[i+2]);
+		// printf("%d %d %d %d %d\n", a, b, buffer[i+0], buffer[i+1], buffer[i+2]);
+#ifdef EDVS_LOG_ULTRA
+		printf("t: %d %d %d -> %ld\n", buffer[i], buffer[i+1], buffer[i+2], timestamp);
+#endif
+	}
+	else if(timestamp_mode == 3) {
+		timestamp =
+			  ((uint64_t)(buffer[i  ]) << 24)
+			| ((uint64_t)(buffer[i+1]) << 16)
+			| ((uint64_t)(buffer[i+2]) <<  8)
+			|  (uint64_t)(buffer[i+3]);
+	}
+	else {
+		timestamp = 0;
+	}
+//	printf("%p %zd\n", s, timestamp);
+	// advance byte count
+	i += cNumBytesTimestamp;
+	// compute event time
+// 		if(s->host_timestamp_mode == 2) {
+// 			// compute time since last
+// 			// FIXME this does not assure that timestamps are increasing!!!
+// 			uint64_t dt;
+// 			if(timestamp < s->last_timestamp) {
+// 				// we have a wrap
+// 				dt = cTimestampLimit + timestamp - s->last_timestamp;
+// 			}
+// 			else {
+// 				// we do not have a wrap
+// 				// OR long time no event => ignore
+// 				dt = s->last_timestamp - timestamp;
+// 			}
+// 			s->current_time = system_clock_time + dt;
+// 			s->last_timestamp = timestamp;
+// 			// // OLD
+// 			// if(s->last_timestamp == cTimestampLimit) {
+// 			// // 	// start event time at zero
+// 			// // 	// FIXME this is problematic with multiple event streams
+// 			// // 	//       as they will have different offsets
+// 			// // 	s->last_timestamp = system_clock_time;
+// 			// 	s->last_timestamp = 0; // use system clock time zero point
+// 			// }
+// 			// s->current_time = system_clock_time;
+// 			// s->last_timestamp = system_clock_time;
+// 		}
+// 		else if(s->host_timestamp_mode == 1) {
+// 			if(timestamp_mode != 0) {
+// 				if(s->current_time < 8) { // ignore timestamps of first 8 events
+// 					s->current_time ++;
+// 				}
+// 				else {
+// 					if(s->last_timestamp != cTimestampLimit) {
+// 						// FIXME possible errors for 16 bit timestamps if no event for more than 65 ms
+// 						// FIXME possible errors for 24/32 bit timestamps if timestamp is wrong
+// 						if(timestamp >= s->last_timestamp) {
+// 							s->current_time += (timestamp - s->last_timestamp);
+// 						}
+// 						else {
+// 							// s->current_time += 2 * timestamp;
+// 							s->current_time += timestamp + (cTimestampLimit - s->last_timestamp);
+// 						}
+// 					}
+// 				}
+// 			}
+// //			printf("old=%lu \tnew=%lu \tt=%lu\n", s->last_timestamp, timestamp, s->current_time);
+// 			s->last_timestamp = timestamp;
+// 		}
+// 		else {
+// 			s->current_time = timestamp;
+// 		}
+
+	if(with_special && a == 0 && b == 0) {
+		// create special
+		edvs_special_t* sp = *special_it;
+		sp->t = timestamp; // FIXME s->current_time;
+		sp->n = special_data_len;
+		// read special data
+#ifdef EDVS_LOG_ULTRA
+		printf("SPECIAL DATA:");
+#endif
+		for(size_t k=0; k<sp->n; k++) {
+			sp->data[k] = buffer[i+k];
+#ifdef EDVS_LOG_ULTRA
+			printf(" %d", sp->data[k]);
+#endif
+		}
+#ifdef EDVS_LOG_ULTRA
+		printf("\n");
+#endif
+		i += sp->n;
+		(*special_it)++;
+	}
+	else {
+		// create event
+		edvs_event_t* e = *event_it;
+		e->t = timestamp;
+		e->x = (uint16_t)(b & cLowerBitsMask);
+		e->y = (uint16_t)(a & cLowerBitsMask);
+		e->parity = ((b & cHighBitMask) ? 1 : 0);
+		e->id = 0;
+		(*event_it)++;
+	}
+	return i;
+}
+
+/** Decodes 'n' regular events with a fixed layout (no checks)
+ * 'mode' is always a constant so that the compiler generates one
+ * specialized kernel per timestamp mode.
+ */
+EDVS_ALWAYS_INLINE
+void decode_events(const unsigned char* p, size_t n, edvs_event_t* events, const int mode)
+{
+	const unsigned int stride = 2 + timestamp_num_bytes(mode);
+	for(size_t j=0; j<n; j++, p+=stride) {
+		uint64_t t;
+		switch(mode) {
+		case 1: t = ((uint64_t)p[2] << 8) | (uint64_t)p[3]; break;
+		case 2: t = ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 8) | (uint64_t)p[4]; break;
+		case 3: t = ((uint64_t)p[2] << 24) | ((uint64_t)p[3] << 16) | ((uint64_t)p[4] << 8) | (uint64_t)p[5]; break;
+		default: t = 0; break;
+		}
+		edvs_event_t* e = events + j;
+		e->t = t;
+		e->x = (uint16_t)(p[1] & cLowerBitsMask);
+		e->y = (uint16_t)(p[0] & cLowerBitsMask);
+		e->parity = p[1] >> 7;
+		e->id = 0;
+	}
+}
+
+#if defined(__SSE2__)
+/** High bits of 64 consecutive bytes */
+uint64_t high_bits_64_sse2(const unsigned char* p)
+{
+	const uint64_t m0 = (uint16_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(p     )));
+	const uint64_t m1 = (uint16_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(p + 16)));
+	const uint64_t m2 = (uint16_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(p + 32)));
+	const uint64_t m3 = (uint16_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(p + 48)));
+	return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+}
+
+__attribute__((target("avx2")))
+uint64_t high_bits_64_avx2(const unsigned char* p)
+{
+	const uint64_t m0 = (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(p     )));
+	const uint64_t m1 = (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(p + 32)));
+	return m0 | (m1 << 32);
+}
+
+typedef uint64_t (*high_bits_64_f)(const unsigned char*);
+
+/** Selects the widest available instruction set once */
+high_bits_64_f high_bits_64_select()
+{
+	static high_bits_64_f f = 0;
+	if(f == 0) {
+		__builtin_cpu_init();
+		f = __builtin_cpu_supports("avx2") ? &high_bits_64_avx2 : &high_bits_64_sse2;
+	}
+	return f;
+}
+#endif
+
+/** Decodes a run of regular events (fast path)
+ * Stops at the first event which does not start with a set high bit, i.e.
+ * at a byte error or at special data. Blocks of 64 bytes are checked at once
+ * with SIMD instructions if available.
+ * @param p first byte of the run
+ * @param num_bytes events must start before this offset
+ * @param num_bytes_valid number of readable bytes starting at p
+ * @return number of decoded events
+ */
+EDVS_ALWAYS_INLINE
+size_t parse_run(const unsigned char* p, size_t num_bytes, size_t num_bytes_valid, edvs_event_t* events, size_t n, const int mode)
+{
+	const unsigned int stride = 2 + timestamp_num_bytes(mode);
+	size_t num_events = (num_bytes + stride - 1) / stride;
+	if(num_events > n) {
+		num_events = n;
+	}
+	size_t k = 0;
+#if defined(__SSE2__)
+	const unsigned int block = 64 / stride;
+	uint64_t pattern = 0;
+	for(unsigned int j=0; j<block; j++) {
+		pattern |= 1ull << (j*stride);
+	}
+	high_bits_64_f high_bits_64 = high_bits_64_select();
+	while(k + block <= num_events && k*stride + 64 <= num_bytes_valid) {
+		const uint64_t missing = ~high_bits_64(p + k*stride) & pattern;
+		if(missing != 0) {
+			// decode the valid events in front of the first bad one
+			const size_t m = __builtin_ctzll(missing) / stride;
+			decode_events(p + k*stride, m, events + k, mode);
+			return k + m;
+		}
+		decode_events(p + k*stride, block, events + k, mode);
+		k += block;
+	}
+#endif
+	// scalar for the remainder
+	size_t m = k;
+	while(m < num_events && (p[m*stride] & cHighBitMask) != 0) {
+		m++;
+	}
+	decode_events(p + k*stride, m - k, events + k, mode);
+	return m;
+}
+
+size_t edvs_parse_events_impl(const unsigned char* buffer, size_t num_bytes, int device_tsm,
+	edvs_event_t* events, size_t* num_events, edvs_special_t* special, size_t* ns, int use_fast)
+{
+	const unsigned int cNumBytesTimestamp = timestamp_num_bytes(device_tsm);
 	const unsigned int cNumBytesPerEvent = 2 + cNumBytesTimestamp;
 	const unsigned int cNumBytesPerSpecial = 2 + cNumBytesTimestamp + 1 + 16;
 	const unsigned int cNumBytesAhead = (cNumBytesPerEvent > cNumBytesPerSpecial) ? cNumBytesPerEvent : cNumBytesPerSpecial;
-	// read bytes
-	unsigned char* buffer_begin = s->buffer;
-	unsigned char* buffer = buffer_begin;
-	size_t num_bytes_events = n*cNumBytesPerEvent;
-	size_t num_bytes_buffer = s->length - s->offset;
-	size_t num_read = (num_bytes_buffer < num_bytes_events ? num_bytes_buffer : num_bytes_events);
-	ssize_t bytes_read = edvs_device_read(s->device, buffer + s->offset, num_read);
+	const int with_special = (special != 0 && ns != 0);
+	const size_t num_special_max = with_special ? *ns : 0;
+	const size_t num_events_max = *num_events;
+	size_t i = 0; // index of current byte
+	edvs_event_t* event_it = events;
+	edvs_special_t* special_it = special;
 #ifdef EDVS_LOG_ULTRA
-	printf("Read %zd bytes from device\n", bytes_read);
-	{
-		for(ssize_t i=0; i<bytes_read; i++) {
-			printf("%c", *(buffer + s->offset + i));
+	printf("START\n");
+#endif
+	while(i + cNumBytesAhead < num_bytes) {
+		// break if no more room for special
+		if(with_special && (size_t)(special_it - special) >= num_special_max) {
+			break;
+		}
+		// break if no more room for events
+		const size_t room = num_events_max - (event_it - events);
+		if(room == 0) {
+			break;
+		}
+		// decode a run of regular events without any checks
+		if(use_fast && device_tsm >= 0 && device_tsm <= 3) {
+			// events starting before this offset are parsed (same as the careful loop)
+			const size_t num_bytes_run = num_bytes - cNumBytesAhead - i;
+			size_t k;
+			switch(device_tsm) {
+			case 0: k = parse_run(buffer + i, num_bytes_run, num_bytes - i, event_it, room, 0); break;
+			case 1: k = parse_run(buffer + i, num_bytes_run, num_bytes - i, event_it, room, 1); break;
+			case 2: k = parse_run(buffer + i, num_bytes_run, num_bytes - i, event_it, room, 2); break;
+			default: k = parse_run(buffer + i, num_bytes_run, num_bytes - i, event_it, room, 3); break;
+			}
+			i += k*cNumBytesPerEvent;
+			event_it += k;
+			if(k > 0) {
+				continue;
+			}
+		}
+		// careful path for special data and byte errors
+		i += parse_careful(buffer + i, device_tsm, with_special, &event_it, &special_it);
+	}
+	*num_events = event_it - events;
+	if(ns != 0) {
+		*ns = with_special ? (size_t)(special_it - special) : 0;
+	}
+	return i;
+}
+
+size_t edvs_parse_events(const unsigned char* buffer, size_t num_bytes, int device_tsm,
+	edvs_event_t* events, size_t* num_events, edvs_special_t* special, size_t* ns)
+{
+	return edvs_parse_events_impl(buffer, num_bytes, device_tsm, events, num_events, special, ns, 1);
+}
+
+size_t edvs_parse_events_careful(const unsigned char* buffer, size_t num_bytes, int device_tsm,
+	edvs_event_t* events, size_t* num_events, edvs_special_t* special, size_t* ns)
+{
+	return edvs_parse_events_impl(buffer, num_bytes, device_tsm, events, num_events, special, ns, 0);
+}
+
+ssize_t edvs_device_streaming_fill_uring(edvs_device_streaming_t* s)
+{
+	if(edvs_device_streaming_submit_uring(s) != 0) {
+		return -1;
+	}
+	if(!edvs_uring_is_pending(s->uring)) {
+		// buffer is full
+		return 0;
+	}
+	ssize_t bytes_read = edvs_uring_wait_read(s->uring);
+	if(bytes_read <= 0) {
+		return bytes_read;
+	}
+	s->ring.end += bytes_read;
+	// the next read fills the buffer while the caller parses
+	if(edvs_device_streaming_submit_uring(s) != 0) {
+		return -1;
+	}
+	return bytes_read;
+}
+
+ssize_t edvs_device_streaming_fill(edvs_device_streaming_t* s)
+{
+	if(s->uring) {
+		return edvs_device_streaming_fill_uring(s);
+	}
+	size_t num_free;
+	unsigned char* dst = edvs_byte_ring_write_ptr(&s->ring, &num_free);
+	if(num_free == 0) {
+		return 0;
+	}
+	ssize_t bytes_read = edvs_device_read(s->device, dst, num_free);
+#ifdef EDVS_LOG_ULTRA
+	printf("Read %zd bytes from device\n", bytes_read);
+	{
+		for(ssize_t i=0; i<bytes_read; i++) {
+			printf("%c", *(dst + i));
+		}
+		printf("\n");
+	}
+#endif
+	if(bytes_read > 0) {
+		s->ring.end += bytes_read;
+	}
+	return bytes_read;
+}
+
+size_t edvs_device_streaming_parse(edvs_device_streaming_t* s, edvs_event_t* events, size_t n, edvs_special_t* special, size_t* ns, uint64_t system_clock_time)
+{
+	// constants
+	const int timestamp_mode = (s->device_timestamp_mode > 3) ? 0 : s->device_timestamp_mode;
+	const uint64_t cTimestampLimit = timestamp_limit(timestamp_mode);
+	// parse events directly from the ring buffer
+	size_t num_bytes;
+	const unsigned char* src = edvs_byte_ring_read_ptr(&s->ring, &num_bytes);
+	size_t num_events = n;
+	size_t i = edvs_parse_events(src, num_bytes, s->device_timestamp_mode, events, &num_events, special, ns);
+	// i is now the number of processed bytes
+	edvs_byte_ring_consume(&s->ring, i);
+	if(s->uring && i > 0) {
+		// parsing made room for the next read
+		edvs_device_streaming_submit_uring(s);
+	}
+#ifdef EDVS_LOG_ULTRA
+	printf("Parsed %zd events\n", num_events);
+#endif
+	// correct timestamps
+	if(num_events > 0) {
+		uint64_t last_device = s->ts_last_device;
+		uint64_t last_host = s->ts_last_host;
+		if(s->ts_last_host == c_uint64_t_max) {
+			last_device = events->t;
+			last_host = 0;
+		}
+//		printf("LAST DEVICE %"PRIu64"\n", last_device);
+//		printf("LAST HOST %"PRIu64"\n", last_host);
+		s->ts_last_device = (events + num_events - 1)->t;
+		if(s->host_timestamp_mode == 1) {
+			compute_timestamps_incremental(events, num_events, last_device, last_host, cTimestampLimit);
+		}
+		if(s->host_timestamp_mode == 2) {
+			compute_timestamps_systime(events, num_events, last_device, last_host, cTimestampLimit, system_clock_time - s->systime_offset);
+		}
+		s->ts_last_host = (events + num_events - 1)->t;
+	}
+	return num_events;
+}
+
+ssize_t edvs_device_streaming_read(edvs_device_streaming_t* s, edvs_event_t* events, size_t n, edvs_special_t* special, size_t* ns)
+{
+	// realtime timer
+	uint64_t system_clock_time = 0;
+	if(s->host_timestamp_mode == 2) {
+		system_clock_time = get_micro_time();
+#ifdef EDVS_LOG_ULTRA
+		printf("Time: %ld\n", system_clock_time);
+#endif
+	}
+	// first parse bytes which are already buffered
+	const size_t ns_max = (ns != 0) ? *ns : 0;
+	size_t num_events = edvs_device_streaming_parse(s, events, n, special, ns, system_clock_time);
+	if(num_events > 0 || (ns != 0 && *ns > 0)) {
+		return num_events;
+	}
+	// only read from the device (may block) if nothing could be parsed
+	ssize_t bytes_read = edvs_device_streaming_fill(s);
+	if(bytes_read < 0) {
+		return bytes_read;
+	}
+	if(ns != 0) {
+		*ns = ns_max;
+	}
+	return edvs_device_streaming_parse(s, events, n, special, ns, system_clock_time);
+}
+
+int edvs_device_streaming_write(edvs_device_streaming_t* s, const char* cmd, size_t n)
+{
+	if(edvs_device_write(s->device, cmd, n) != n)
+		return -1;
+	return 0;
+}
+
+int edvs_device_streaming_stop(edvs_device_streaming_t* s)
+{
+	int r = edvs_device_streaming_write(s, "E-\n", 3);
+	if(r != 0) return r;
+	if(s->uring) {
+		edvs_uring_close(s->uring);
+	}
+	edvs_byte_ring_free(&s->ring);
+	free(s);
+	return 0;
+}
+
+// ----- ----- ----- ----- ----- ----- ----- ----- ----- //
+
+ssize_t edvs_file_read(FILE* fh, edvs_event_t* events, size_t n)
+{
+	return fread((void*)events, sizeof(edvs_event_t), n, fh);
+}
+
+ssize_t edvs_file_write(FILE* fh, const edvs_event_t* events, size_t n)
+{
+	size_t m = fwrite((const void*)events, sizeof(edvs_event_t), n, fh);
+	if(m != n) {
+		printf("edvs_file_write: could not write to file\n");
+		return -1;
+	}
+	return m;
+}
+
+// ----- ----- ----- ----- ----- ----- ----- ----- ----- //
+
+static inline unsigned char* put_varint(unsigned char* p, uint64_t v)
+{
+	while(v >= 0x80) {
+		*p++ = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (unsigned char)v;
+	return p;
+}
+
+/** Reads a varint with at most 10 bytes */
+static inline __attribute__((always_inline)) const unsigned char* get_varint(const unsigned char* p, uint64_t* v)
+{
+	// most timestamp deltas fit into one or two bytes
+	if(p[0] < 0x80) {
+		*v = p[0];
+		return p + 1;
+	}
+	if(p[1] < 0x80) {
+		*v = (uint64_t)(p[0] & 0x7F) | ((uint64_t)p[1] << 7);
+		return p + 2;
+	}
+	uint64_t x = 0;
+	for(unsigned i=0; i<10; i++) {
+		x |= (uint64_t)(p[i] & 0x7F) << (7*i);
+		if(p[i] < 0x80) {
+			*v = x;
+			return p + i + 1;
+		}
+	}
+	*v = x;
+	return p + 10;
+}
+
+size_t edvs_delta_encode(const edvs_event_t* events, size_t n, uint64_t* t, uint8_t* id, unsigned char* data)
+{
+	unsigned char* p = data;
+	uint64_t last_t = *t;
+	uint8_t last_id = *id;
+	for(size_t i=0; i<n; i++) {
+		const edvs_event_t* e = events + i;
+		// zigzag encoding, so that unordered timestamps stay small
+		const int64_t dt = (int64_t)(e->t - last_t);
+		p = put_varint(p, ((uint64_t)dt << 1) ^ (uint64_t)(dt >> 63));
+		last_t = e->t;
+		const int large = (e->x >= 128 || e->y >= 128 || e->parity > 1);
+		const int extended = (large || e->id != last_id);
+		const uint16_t xyp = large ? 0x8000 :
+			(e->x | (e->y << 7) | (e->parity << 14) | (extended << 15));
+		*p++ = xyp & 0xFF;
+		*p++ = xyp >> 8;
+		if(extended) {
+			p = put_varint(p, e->id | (large << 8));
+			last_id = e->id;
+			if(large) {
+				*p++ = e->x & 0xFF;
+				*p++ = e->x >> 8;
+				*p++ = e->y & 0xFF;
+				*p++ = e->y >> 8;
+				*p++ = e->parity;
+			}
+		}
+	}
+	*t = last_t;
+	*id = last_id;
+	return p - data;
+}
+
+ssize_t edvs_delta_decode(const unsigned char* data, size_t num_bytes, uint64_t t0, edvs_event_t* events, size_t n)
+{
+	const unsigned char* p = data;
+	const unsigned char* end = data + num_bytes;
+	uint64_t t = t0;
+	uint8_t id = 0;
+	for(size_t i=0; i<n; i++) {
+		edvs_event_t* e = events + i;
+		uint64_t v;
+		p = get_varint(p, &v);
+		t += (v >> 1) ^ (0 - (v & 1));
+		const unsigned xyp = p[0] | (p[1] << 8);
+		p += 2;
+		e->t = t;
+		e->x = xyp & 0x7F;
+		e->y = (xyp >> 7) & 0x7F;
+		e->parity = (xyp >> 14) & 1;
+		if(xyp & 0x8000) {
+			p = get_varint(p, &v);
+			id = v & 0xFF;
+			if(v & 0x100) {
+				e->x = p[0] | (p[1] << 8);
+				e->y = p[2] | (p[3] << 8);
+				e->parity = p[4];
+				p += 5;
+			}
+		}
+		e->id = id;
+		// one event reads at most EDVS_DELTA_MAX_EVENT_BYTES, so checking once is enough
+		if(p > end) {
+			return -1;
+		}
+	}
+	return p - data;
+}
+
+// ----- ----- ----- ----- ----- ----- ----- ----- ----- //
+
+#ifdef EDVS_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef EDVS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+int edvs_file_compression_supported(uint32_t compression)
+{
+	switch(compression) {
+	case EDVS_COMPRESSION_NONE:
+		return 1;
+#ifdef EDVS_HAVE_ZLIB
+	case EDVS_COMPRESSION_ZLIB:
+		return 1;
+#endif
+#ifdef EDVS_HAVE_ZSTD
+	case EDVS_COMPRESSION_ZSTD:
+		return 1;
+#endif
+	default:
+		return 0;
+	}
+}
+
+/** Maximum size of 'n' bytes after compression */
+size_t edvs_compress_bound(uint32_t compression, size_t n)
+{
+	switch(compression) {
+#ifdef EDVS_HAVE_ZLIB
+	case EDVS_COMPRESSION_ZLIB:
+		return compressBound(n);
+#endif
+#ifdef EDVS_HAVE_ZSTD
+	case EDVS_COMPRESSION_ZSTD:
+		return ZSTD_compressBound(n);
+#endif
+	default:
+		return n;
+	}
+}
+
+/** Compresses bytes, returns the compressed size or -1 */
+ssize_t edvs_compress(uint32_t compression, const unsigned char* src, size_t n, unsigned char* dst, size_t dst_size)
+{
+	switch(compression) {
+#ifdef EDVS_HAVE_ZLIB
+	case EDVS_COMPRESSION_ZLIB: {
+		// recordings are written live, so prefer speed
+		uLongf m = dst_size;
+		return (compress2(dst, &m, src, n, Z_BEST_SPEED) == Z_OK) ? (ssize_t)m : -1;
+	}
+#endif
+#ifdef EDVS_HAVE_ZSTD
+	case EDVS_COMPRESSION_ZSTD: {
+		size_t m = ZSTD_compress(dst, dst_size, src, n, 3);
+		return ZSTD_isError(m) ? -1 : (ssize_t)m;
+	}
+#endif
+	default:
+		return -1;
+	}
+}
+
+/** Decompresses bytes, returns the decompressed size or -1 */
+ssize_t edvs_decompress(uint32_t compression, const unsigned char* src, size_t n, unsigned char* dst, size_t dst_size)
+{
+	switch(compression) {
+#ifdef EDVS_HAVE_ZLIB
+	case EDVS_COMPRESSION_ZLIB: {
+		uLongf m = dst_size;
+		return (uncompress(dst, &m, src, n) == Z_OK) ? (ssize_t)m : -1;
+	}
+#endif
+#ifdef EDVS_HAVE_ZSTD
+	case EDVS_COMPRESSION_ZSTD: {
+		size_t m = ZSTD_decompress(dst, dst_size, src, n);
+		return ZSTD_isError(m) ? -1 : (ssize_t)m;
+	}
+#endif
+	default:
+		return -1;
+	}
+}
+
+/** Files with encoded or compressed events have a header in front of each chunk */
+int edvs_file_has_chunk_headers(const edvs_file_header_t* header)
+{
+	return header->encoding != EDVS_ENCODING_RAW || header->compression != EDVS_COMPRESSION_NONE;
+}
+
+/** Maximum size of 'n' encoded events before compression */
+uint64_t edvs_file_max_encoded_bytes(const edvs_file_header_t* header, uint64_t n)
+{
+	return n*((header->encoding == EDVS_ENCODING_DELTA) ? EDVS_DELTA_MAX_EVENT_BYTES : sizeof(edvs_event_t));
+}
+
+/** Grows a buffer to at least 'size' bytes */
+int edvs_reserve(unsigned char** buffer, size_t* buffer_size, size_t size)
+{
+	if(size <= *buffer_size) {
+		return 0;
+	}
+	free(*buffer);
+	*buffer = (unsigned char*)malloc(size);
+	*buffer_size = (*buffer == 0) ? 0 : size;
+	return (*buffer == 0) ? -1 : 0;
+}
+
+void edvs_file_block_free(edvs_file_block_t* b)
+{
+	free(b->data);
+	free(b->buffer);
+	free(b->events);
+	memset(b, 0, sizeof(edvs_file_block_t));
+}
+
+/** Checks the chunk header and allocates buffers for the stored bytes */
+int edvs_file_block_prepare(const edvs_file_header_t* header, edvs_file_block_t* b)
+{
+	const uint64_t max_bytes = edvs_compress_bound(header->compression,
+		edvs_file_max_encoded_bytes(header, b->header.n));
+	if(b->header.n > header->chunk_size || b->header.num_bytes > max_bytes) {
+		return -1;
+	}
+	if(b->events == 0) {
+		b->events = (edvs_event_t*)malloc((size_t)header->chunk_size*sizeof(edvs_event_t));
+		if(b->events == 0) {
+			return -1;
+		}
+	}
+	// zero padding for the delta decoder
+	if(edvs_reserve(&b->data, &b->data_size, b->header.num_bytes + EDVS_DELTA_MAX_EVENT_BYTES) != 0) {
+		return -1;
+	}
+	memset(b->data + b->header.num_bytes, 0, EDVS_DELTA_MAX_EVENT_BYTES);
+	return 0;
+}
+
+/** Decompresses and decodes the stored bytes of a chunk */
+int edvs_file_block_decode(const edvs_file_header_t* header, edvs_file_block_t* b)
+{
+	const size_t n = b->header.n;
+	const unsigned char* data = b->data;
+	size_t num_bytes = b->header.num_bytes;
+	if(header->compression != EDVS_COMPRESSION_NONE) {
+		if(header->encoding == EDVS_ENCODING_RAW) {
+			// decompress directly into the events
+			const size_t size = n*sizeof(edvs_event_t);
+			return (edvs_decompress(header->compression, data, num_bytes, (unsigned char*)b->events, size) == (ssize_t)size) ? 0 : -1;
+		}
+		const size_t max_bytes = edvs_file_max_encoded_bytes(header, n);
+		if(edvs_reserve(&b->buffer, &b->buffer_size, max_bytes + EDVS_DELTA_MAX_EVENT_BYTES) != 0) {
+			return -1;
+		}
+		ssize_t m = edvs_decompress(header->compression, data, num_bytes, b->buffer, max_bytes);
+		if(m < 0) {
+			return -1;
+		}
+		memset(b->buffer + m, 0, EDVS_DELTA_MAX_EVENT_BYTES);
+		data = b->buffer;
+		num_bytes = m;
+	}
+	// uncompressed chunks with header are always delta encoded
+	return (edvs_delta_decode(data, num_bytes, b->header.t, b->events, n) < 0) ? -1 : 0;
+}
+
+// ----- ----- ----- ----- ----- ----- ----- ----- ----- //
+
+#include <pthread.h>
+
+/** Reads and decodes chunks ahead of the reader on worker threads
+ * Chunk c is decoded into block c % num_blocks. The reader holds chunk 'first',
+ * so workers only decode chunks in [first, first + num_blocks[.
+ */
+struct edvs_file_decoder_t {
+	int fd;
+	const edvs_file_header_t* header;
+	const edvs_file_chunk_t* chunks;
+	uint64_t num_chunks;
+	pthread_t* threads;
+	size_t num_threads;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	edvs_file_block_t* blocks;
+	uint64_t* block_chunk; // chunk in block, c_uint64_t_max if none
+	int* block_state; // 0 if decoded, -1 on error
+	size_t num_blocks;
+	uint64_t first; // chunk held by the reader
+	uint64_t next_job; // next chunk to decode
+	uint64_t end_job; // end of the decoding window
+	size_t num_busy;
+	int stop;
+};
+
+void* edvs_file_decoder_thread(void* arg)
+{
+	struct edvs_file_decoder_t* d = (struct edvs_file_decoder_t*)arg;
+	const size_t hs = sizeof(edvs_file_chunk_header_t);
+	pthread_mutex_lock(&d->mutex);
+	while(1) {
+		while(!d->stop && d->next_job >= d->end_job) {
+			pthread_cond_wait(&d->cond, &d->mutex);
+		}
+		if(d->stop) {
+			break;
+		}
+		const uint64_t c = d->next_job++;
+		const size_t k = c % d->num_blocks;
+		d->num_busy++;
+		pthread_mutex_unlock(&d->mutex);
+		// read and decode without holding the lock
+		edvs_file_block_t* b = d->blocks + k;
+		const uint64_t offset = d->chunks[c].offset;
+		int state = -1;
+		if(pread(d->fd, &b->header, hs, offset) == (ssize_t)hs
+			&& edvs_file_block_prepare(d->header, b) == 0
+			&& pread(d->fd, b->data, b->header.num_bytes, offset + hs) == (ssize_t)b->header.num_bytes
+			&& edvs_file_block_decode(d->header, b) == 0) {
+			state = 0;
+		}
+		pthread_mutex_lock(&d->mutex);
+		d->block_chunk[k] = c;
+		d->block_state[k] = state;
+		d->num_busy--;
+		pthread_cond_broadcast(&d->cond);
+	}
+	pthread_mutex_unlock(&d->mutex);
+	return 0;
+}
+
+struct edvs_file_decoder_t* edvs_file_decoder_open(int fd, const edvs_file_header_t* header, const edvs_file_chunk_t* chunks, uint64_t num_chunks)
+{
+	struct edvs_file_decoder_t* d = (struct edvs_file_decoder_t*)malloc(sizeof(struct edvs_file_decoder_t));
+	if(d == 0) {
+		return 0;
+	}
+	long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	d->fd = fd;
+	d->header = header;
+	d->chunks = chunks;
+	d->num_chunks = num_chunks;
+	d->num_threads = (num_cpus < 1) ? 1 : ((num_cpus > 8) ? 8 : num_cpus);
+	d->num_blocks = 2*d->num_threads;
+	d->threads = (pthread_t*)malloc(d->num_threads*sizeof(pthread_t));
+	d->blocks = (edvs_file_block_t*)calloc(d->num_blocks, sizeof(edvs_file_block_t));
+	d->block_chunk = (uint64_t*)malloc(d->num_blocks*sizeof(uint64_t));
+	d->block_state = (int*)calloc(d->num_blocks, sizeof(int));
+	if(d->threads == 0 || d->blocks == 0 || d->block_chunk == 0 || d->block_state == 0) {
+		printf("edvs_file_decoder_open: out of memory\n");
+		free(d->threads);
+		free(d->blocks);
+		free(d->block_chunk);
+		free(d->block_state);
+		free(d);
+		return 0;
+	}
+	for(size_t k=0; k<d->num_blocks; k++) {
+		d->block_chunk[k] = c_uint64_t_max;
+	}
+	d->first = 0;
+	d->next_job = 0;
+	d->end_job = 0;
+	d->num_busy = 0;
+	d->stop = 0;
+	pthread_mutex_init(&d->mutex, 0);
+	pthread_cond_init(&d->cond, 0);
+	size_t i = 0;
+	for(; i<d->num_threads; i++) {
+		if(pthread_create(d->threads + i, 0, edvs_file_decoder_thread, d) != 0) {
+			break;
+		}
+	}
+	d->num_threads = i;
+	if(i == 0) {
+		printf("edvs_file_decoder_open: could not start threads\n");
+	}
+	return d;
+}
+
+/** Waits until chunk 'c' is decoded and moves the decoding window to it
+ * The returned block is valid until the next call.
+ */
+edvs_file_block_t* edvs_file_decoder_get(struct edvs_file_decoder_t* d, uint64_t c)
+{
+	if(c >= d->num_chunks || d->num_threads == 0) {
+		return 0;
+	}
+	const size_t k = c % d->num_blocks;
+	pthread_mutex_lock(&d->mutex);
+	if(c < d->first || d->next_job <= c) {
+		// chunk is not in the current window (seek), restart decoding at c
+		while(d->num_busy > 0) {
+			pthread_cond_wait(&d->cond, &d->mutex);
+		}
+		for(size_t i=0; i<d->num_blocks; i++) {
+			d->block_chunk[i] = c_uint64_t_max;
+		}
+		d->next_job = c;
+	}
+	d->first = c;
+	d->end_job = c + d->num_blocks;
+	if(d->end_job > d->num_chunks) {
+		d->end_job = d->num_chunks;
+	}
+	pthread_cond_broadcast(&d->cond);
+	while(d->block_chunk[k] != c) {
+		pthread_cond_wait(&d->cond, &d->mutex);
+	}
+	const int state = d->block_state[k];
+	pthread_mutex_unlock(&d->mutex);
+	return (state == 0) ? d->blocks + k : 0;
+}
+
+void edvs_file_decoder_close(struct edvs_file_decoder_t* d)
+{
+	pthread_mutex_lock(&d->mutex);
+	d->stop = 1;
+	pthread_cond_broadcast(&d->cond);
+	pthread_mutex_unlock(&d->mutex);
+	for(size_t i=0; i<d->num_threads; i++) {
+		pthread_join(d->threads[i], 0);
+	}
+	for(size_t k=0; k<d->num_blocks; k++) {
+		edvs_file_block_free(d->blocks + k);
+	}
+	pthread_mutex_destroy(&d->mutex);
+	pthread_cond_destroy(&d->cond);
+	free(d->threads);
+	free(d->blocks);
+	free(d->block_chunk);
+	free(d->block_state);
+	free(d);
+}
+
+// ----- ----- ----- ----- ----- ----- ----- ----- ----- //
+
+void edvs_file_header_init(edvs_file_header_t* header)
+{
+	memset(header, 0, sizeof(edvs_file_header_t));
+	memcpy(header->magic, EDVS_FILE_MAGIC, 8);
+	header->version = EDVS_FILE_VERSION;
+	header->header_size = sizeof(edvs_file_header_t);
+	header->encoding = EDVS_ENCODING_RAW;
+	header->chunk_size = EDVS_FILE_DEFAULT_CHUNK_SIZE;
+	header->width = 128;
+	header->height = 128;
+	header->time_unit_ns = 1000;
+}
+
+edvs_file_writer_t* edvs_file_writer_open(FILE* fh, const edvs_file_header_t* header)
+{
+	edvs_file_writer_t* w = (edvs_file_writer_t*)malloc(sizeof(edvs_file_writer_t));
+	if(w == 0) {
+		return 0;
+	}
+	w->fh = fh;
+	w->header = *header;
+	memcpy(w->header.magic, EDVS_FILE_MAGIC, 8);
+	w->header.version = EDVS_FILE_VERSION;
+	w->header.header_size = sizeof(edvs_file_header_t);
+	if(w->header.chunk_size == 0) {
+		w->header.chunk_size = EDVS_FILE_DEFAULT_CHUNK_SIZE;
+	}
+	w->header.num_events = 0;
+	w->header.index_offset = 0;
+	w->chunks = 0;
+	w->num_chunks = 0;
+	w->max_chunks = 0;
+	w->num_in_chunk = 0;
+	w->offset = w->header.header_size;
+	w->data = 0;
+	w->num_bytes = 0;
+	w->compressed = 0;
+	w->compressed_size = 0;
+	w->last_t = 0;
+	w->last_id = 0;
+	if(w->header.encoding != EDVS_ENCODING_RAW && w->header.encoding != EDVS_ENCODING_DELTA) {
+		printf("edvs_file_writer_open: unsupported encoding %u\n", w->header.encoding);
+		free(w);
+		return 0;
+	}
+	if(!edvs_file_compression_supported(w->header.compression)) {
+		printf("edvs_file_writer_open: unsupported compression %u\n", w->header.compression);
+		free(w);
+		return 0;
+	}
+	if(edvs_file_has_chunk_headers(&w->header)) {
+		const size_t max_bytes = edvs_file_max_encoded_bytes(&w->header, w->header.chunk_size);
+		w->data = (unsigned char*)malloc(max_bytes);
+		if(w->header.compression != EDVS_COMPRESSION_NONE) {
+			w->compressed_size = edvs_compress_bound(w->header.compression, max_bytes);
+			w->compressed = (unsigned char*)malloc(w->compressed_size);
+		}
+		if(w->data == 0 || (w->header.compression != EDVS_COMPRESSION_NONE && w->compressed == 0)) {
+			printf("edvs_file_writer_open: out of memory\n");
+			free(w->data);
+			free(w->compressed);
+			free(w);
+			return 0;
+		}
+	}
+	if(fwrite(&w->header, sizeof(edvs_file_header_t), 1, fh) != 1) {
+		printf("edvs_file_writer_open: could not write header\n");
+		free(w->data);
+		free(w->compressed);
+		free(w);
+		return 0;
+	}
+	return w;
+}
+
+/** Compresses and writes the events of the current chunk (chunks with header only) */
+int edvs_file_writer_flush_chunk(edvs_file_writer_t* w)
+{
+	if(w->num_bytes == 0) {
+		return 0;
+	}
+	edvs_file_chunk_header_t ch;
+	ch.t = w->chunks[w->num_chunks - 1].t;
+	ch.n = w->num_in_chunk;
+	const unsigned char* data = w->data;
+	ssize_t num_bytes = w->num_bytes;
+	if(w->header.compression != EDVS_COMPRESSION_NONE) {
+		num_bytes = edvs_compress(w->header.compression, w->data, w->num_bytes, w->compressed, w->compressed_size);
+		if(num_bytes < 0) {
+			printf("edvs_file_writer: could not compress chunk\n");
+			return -1;
+		}
+		data = w->compressed;
+	}
+	ch.num_bytes = num_bytes;
+	if(fwrite(&ch, sizeof(edvs_file_chunk_header_t), 1, w->fh) != 1
+		|| fwrite(data, 1, num_bytes, w->fh) != (size_t)num_bytes) {
+		printf("edvs_file_writer: could not write to file\n");
+		return -1;
+	}
+	w->offset += sizeof(edvs_file_chunk_header_t) + num_bytes;
+	w->num_bytes = 0;
+	return 0;
+}
+
+/** Adds an index entry for a new chunk */
+int edvs_file_writer_add_chunk(edvs_file_writer_t* w, uint64_t t)
+{
+	if(w->num_chunks == w->max_chunks) {
+		size_t max_chunks = (w->max_chunks == 0) ? 64 : 2*w->max_chunks;
+		edvs_file_chunk_t* chunks = (edvs_file_chunk_t*)realloc(w->chunks, max_chunks*sizeof(edvs_file_chunk_t));
+		if(chunks == 0) {
+			printf("edvs_file_writer: out of memory\n");
+			return -1;
+		}
+		w->chunks = chunks;
+		w->max_chunks = max_chunks;
+	}
+	edvs_file_chunk_t* c = w->chunks + w->num_chunks;
+	c->t = t;
+	c->offset = w->offset;
+	c->n = 0;
+	w->num_chunks++;
+	w->num_in_chunk = 0;
+	w->last_t = t;
+	w->last_id = 0;
+	return 0;
+}
+
+ssize_t edvs_file_writer_write(edvs_file_writer_t* w, const edvs_event_t* events, size_t n)
+{
+	size_t i = 0;
+	while(i < n) {
+		if(w->num_chunks == 0 || w->num_in_chunk == w->header.chunk_size) {
+			if(edvs_file_writer_flush_chunk(w) != 0
+				|| edvs_file_writer_add_chunk(w, events[i].t) != 0) {
+				return -1;
+			}
+		}
+		// events up to the end of the current chunk
+		size_t m = n - i;
+		if(m > w->header.chunk_size - w->num_in_chunk) {
+			m = w->header.chunk_size - w->num_in_chunk;
+		}
+		if(w->header.encoding == EDVS_ENCODING_DELTA) {
+			// continue the encoding of the current chunk
+			w->num_bytes += edvs_delta_encode(events + i, m, &w->last_t, &w->last_id, w->data + w->num_bytes);
+		}
+		else if(w->header.compression != EDVS_COMPRESSION_NONE) {
+			memcpy(w->data + w->num_bytes, events + i, m*sizeof(edvs_event_t));
+			w->num_bytes += m*sizeof(edvs_event_t);
+		}
+		else {
+			if(edvs_file_write(w->fh, events + i, m) < 0) {
+				return -1;
+			}
+			w->offset += m*sizeof(edvs_event_t);
+		}
+		w->chunks[w->num_chunks - 1].n += m;
+		w->num_in_chunk += m;
+		w->header.num_events += m;
+		i += m;
+	}
+	return n;
+}
+
+int edvs_file_writer_close(edvs_file_writer_t* w)
+{
+	int result = 0;
+	// index
+	uint64_t num_chunks = w->num_chunks;
+	if(edvs_file_writer_flush_chunk(w) != 0) {
+		result = -1;
+	}
+	else if(fwrite(&num_chunks, sizeof(uint64_t), 1, w->fh) != 1
+		|| fwrite(w->chunks, sizeof(edvs_file_chunk_t), w->num_chunks, w->fh) != w->num_chunks) {
+		printf("edvs_file_writer_close: could not write index\n");
+		result = -1;
+	}
+	else {
+		// header with number of events and index position
+		w->header.index_offset = w->offset;
+		if(fseeko(w->fh, 0, SEEK_SET) != 0
+			|| fwrite(&w->header, sizeof(edvs_file_header_t), 1, w->fh) != 1
+			|| fseeko(w->fh, 0, SEEK_END) != 0) {
+			printf("edvs_file_writer_close: could not update header\n");
+			result = -1;
+		}
+	}
+	free(w->chunks);
+	free(w->data);
+	free(w->compressed);
+	free(w);
+	return result;
+}
+
+/** Reads and decodes the next chunk (chunks with header only) */
+int edvs_file_reader_load_chunk(edvs_file_reader_t* r)
+{
+	edvs_file_block_t* b = &r->block;
+	if(r->header.compression != EDVS_COMPRESSION_NONE) {
+		// decompressed ahead on worker threads
+		if(r->decoder == 0) {
+			size_t num_chunks;
+			const edvs_file_chunk_t* chunks = edvs_file_reader_index(r, &num_chunks);
+			r->decoder = edvs_file_decoder_open(fileno(r->fh), &r->header, chunks, num_chunks);
+		}
+		b = (r->decoder == 0) ? 0 : edvs_file_decoder_get(r->decoder, r->chunk);
+		if(b == 0) {
+			printf("edvs_file_reader: could not read chunk\n");
+			return -1;
+		}
+	}
+	else if(fread(&b->header, sizeof(edvs_file_chunk_header_t), 1, r->fh) != 1
+		|| edvs_file_block_prepare(&r->header, b) != 0
+		|| fread(b->data, 1, b->header.num_bytes, r->fh) != b->header.num_bytes
+		|| edvs_file_block_decode(&r->header, b) != 0) {
+		printf("edvs_file_reader: could not read chunk\n");
+		return -1;
+	}
+	r->chunk++;
+	r->decoded = b->events;
+	r->num_decoded = b->header.n;
+	r->decoded_position = 0;
+	return 0;
+}
+
+/** Moves the file position to an event */
+int edvs_file_reader_set_position(edvs_file_reader_t* r, uint64_t position)
+{
+	r->position = position;
+	if(!edvs_file_has_chunk_headers(&r->header)) {
+		return fseeko(r->fh, r->header.header_size + position*sizeof(edvs_event_t), SEEK_SET);
+	}
+	// move to the start of the chunk and skip events within the chunk
+	const uint64_t c = position / r->header.chunk_size;
+	r->num_decoded = 0;
+	r->decoded_position = 0;
+	r->chunk = c;
+	if(position >= r->header.num_events) {
+		r->position = r->header.num_events;
+		return 0;
+	}
+	if(r->header.compression == EDVS_COMPRESSION_NONE) {
+		// chunks are read sequentially from the current file position
+		uint64_t offset = r->header.header_size;
+		if(c > 0) {
+			size_t num_chunks;
+			const edvs_file_chunk_t* chunks = edvs_file_reader_index(r, &num_chunks);
+			if(c >= num_chunks) {
+				return -1;
+			}
+			offset = chunks[c].offset;
+		}
+		if(fseeko(r->fh, offset, SEEK_SET) != 0) {
+			return -1;
+		}
+	}
+	const uint64_t skip = position - c*r->header.chunk_size;
+	if(skip > 0) {
+		if(edvs_file_reader_load_chunk(r) != 0) {
+			return -1;
+		}
+		r->decoded_position = skip;
+	}
+	return 0;
+}
+
+edvs_file_reader_t* edvs_file_reader_open(FILE* fh)
+{
+	edvs_file_reader_t* r = (edvs_file_reader_t*)malloc(sizeof(edvs_file_reader_t));
+	if(r == 0) {
+		return 0;
+	}
+	r->fh = fh;
+	r->chunks = 0;
+	r->num_chunks = 0;
+	r->position = 0;
+	r->decoded = 0;
+	r->num_decoded = 0;
+	r->decoded_position = 0;
+	r->chunk = 0;
+	memset(&r->block, 0, sizeof(edvs_file_block_t));
+	r->decoder = 0;
+	// file size
+	if(fseeko(fh, 0, SEEK_END) != 0) {
+		printf("edvs_file_reader_open: file is not seekable\n");
+		free(r);
+		return 0;
+	}
+	const uint64_t file_size = ftello(fh);
+	rewind(fh);
+	// header
+	size_t m = fread(&r->header, 1, sizeof(edvs_file_header_t), fh);
+	if(m < 8 || memcmp(r->header.magic, EDVS_FILE_MAGIC, 8) != 0) {
+		// plain event file without header
+		edvs_file_header_init(&r->header);
+		r->header.version = 0;
+		r->header.header_size = 0;
+		r->header.num_events = file_size / sizeof(edvs_event_t);
+	}
+	else {
+		if(m != sizeof(edvs_file_header_t) || r->header.version > EDVS_FILE_VERSION) {
+			printf("edvs_file_reader_open: unsupported file version %u\n", r->header.version);
+			free(r);
+			return 0;
+		}
+		if(r->header.version < 2) {
+			r->header.compression = EDVS_COMPRESSION_NONE;
+		}
+		if(r->header.encoding != EDVS_ENCODING_RAW && r->header.encoding != EDVS_ENCODING_DELTA) {
+			printf("edvs_file_reader_open: unsupported encoding %u\n", r->header.encoding);
+			free(r);
+			return 0;
+		}
+		if(!edvs_file_compression_supported(r->header.compression)) {
+			printf("edvs_file_reader_open: unsupported compression %u\n", r->header.compression);
+			free(r);
+			return 0;
+		}
+		if(r->header.index_offset == 0) {
+			// recording was not closed properly
+			if(!edvs_file_has_chunk_headers(&r->header)) {
+				r->header.num_events = (file_size - r->header.header_size) / sizeof(edvs_event_t);
+			}
+			else {
+				// number of events is only known after scanning the chunks
+				size_t num_chunks;
+				edvs_file_reader_index(r, &num_chunks);
+			}
 		}
-		printf("\n");
-		// char* tmp = malloc(bytes_read + 1);
-		// memcpy(buffer + s->offset, tmp, bytes_read);
-		// tmp[bytes_read] = '\0';
-		// printf("%s\n", tmp);
-		// free(tmp);
 	}
-#endif
-	size_t num_special = 0;
-	if(bytes_read < 0) {
-		return bytes_read;
+	edvs_file_reader_set_position(r, 0);
+	return r;
+}
+
+ssize_t edvs_file_reader_read(edvs_file_reader_t* r, edvs_event_t* events, size_t n)
+{
+	const uint64_t num_left = r->header.num_events - r->position;
+	if(n > num_left) {
+		n = num_left;
+	}
+	if(!edvs_file_has_chunk_headers(&r->header)) {
+		ssize_t m = edvs_file_read(r->fh, events, n);
+		if(m > 0) {
+			r->position += m;
+		}
+		return m;
 	}
-	bytes_read += s->offset;
-	// parse events
-	ssize_t i = 0; // index of current byte
-	edvs_event_t* event_it = events;
-	edvs_special_t* special_it = special;
-#ifdef EDVS_LOG_ULTRA
-	printf("START\n");
-#endif
-	while(i+cNumBytesAhead < bytes_read) {
-		// break if no more room for special
-		if(special != 0 && ns != 0 && num_special >= *ns) {
-			break;
+	// copy decoded events and decode the next chunk when necessary
+	size_t m = 0;
+	while(m < n) {
+		if(r->decoded_position == r->num_decoded && edvs_file_reader_load_chunk(r) != 0) {
+			return (m > 0) ? (ssize_t)m : -1;
 		}
-		// get two bytes
-		unsigned char a = buffer[i];
-		unsigned char b = buffer[i + 1];
-#ifdef EDVS_LOG_ULTRA
-//		printf("e: %d %d\n", a, b);
-#endif
-		i += 2;
-		// check for and parse 1yyyyyyy pxxxxxxx
-		if((a & cHighBitMask) == 0) { // check that the high bit of first byte is 1
-			// the serial port missed a byte somewhere ...
-			// skip one byte to jump to the next event
-			printf("Error in high bit! Skipping a byte\n");
-			i --;
-			continue;
-		}
-		// check for special data
-		size_t special_data_len = 0;
-		if(special != 0 && a == 0 && b == 0) {
-			// get special data length
-			special_data_len = (buffer[i] & 0x0F);
-			// HACK assuming special data always sends timestamp!
-			if(special_data_len >= cNumBytesTimestamp) {
-				special_data_len -= cNumBytesTimestamp;
+		size_t k = r->num_decoded - r->decoded_position;
+		if(k > n - m) {
+			k = n - m;
+		}
+		memcpy(events + m, r->decoded + r->decoded_position, k*sizeof(edvs_event_t));
+		r->decoded_position += k;
+		r->position += k;
+		m += k;
+	}
+	return m;
+}
+
+const edvs_file_chunk_t* edvs_file_reader_index(edvs_file_reader_t* r, size_t* num_chunks)
+{
+	if(r->chunks == 0 && (r->header.num_events > 0 || r->header.index_offset == 0)) {
+		const off_t file_position = ftello(r->fh);
+		if(r->header.index_offset != 0) {
+			// read stored index
+			uint64_t n = 0;
+			if(fseeko(r->fh, r->header.index_offset, SEEK_SET) != 0
+				|| fread(&n, sizeof(uint64_t), 1, r->fh) != 1) {
+				printf("edvs_file_reader_index: could not read index\n");
+				n = 0;
 			}
-			else {
-				printf("ERROR parsing special data length!\n");
+			r->chunks = (edvs_file_chunk_t*)malloc(n*sizeof(edvs_file_chunk_t));
+			if(fread(r->chunks, sizeof(edvs_file_chunk_t), n, r->fh) != n) {
+				printf("edvs_file_reader_index: could not read index\n");
+				n = 0;
 			}
-			i ++;
-#ifdef EDVS_LOG_ULTRA
-//			printf("s: len=%ld\n", special_data_len);
-#endif
+			r->num_chunks = n;
 		}
-		// read timestamp
-		uint64_t timestamp;
-		if(timestamp_mode == 1) {
-			timestamp =
-				  ((uint64_t)(buffer[i  ]) <<  8)
-				|  (uint64_t)(buffer[i+1]);
-		}
-		else if(timestamp_mode == 2) {
-			timestamp =
-				  ((uint64_t)(buffer[i  ]) << 16)
-				| ((uint64_t)(buffer[i+1]) <<  8)
-				|  (uint64_t)(buffer[i+2]);
-			// printf("%d %d %d %d %d\n", a, b, buffer[i+0], buffer[i+1], buffer[i+2]);
-#ifdef EDVS_LOG_ULTRA
-			printf("t: %d %d %d -> %ld\n", buffer[i], buffer[i+1], buffer[i+2], timestamp);
-#endif
-		}
-		else if(timestamp_mode == 3) {
-			timestamp =
-				  ((uint64_t)(buffer[i  ]) << 24)
-				| ((uint64_t)(buffer[i+1]) << 16)
-				| ((uint64_t)(buffer[i+2]) <<  8)
-				|  (uint64_t)(buffer[i+3]);
+		else if(edvs_file_has_chunk_headers(&r->header)) {
+			// rebuild index and number of events from the chunk headers
+			printf("edvs_file_reader_index: file has no index, rebuilding it\n");
+			fseeko(r->fh, 0, SEEK_END);
+			const uint64_t file_size = ftello(r->fh);
+			size_t max_chunks = 0;
+			uint64_t offset = r->header.header_size;
+			r->header.num_events = 0;
+			edvs_file_chunk_header_t ch;
+			while(fseeko(r->fh, offset, SEEK_SET) == 0
+				&& fread(&ch, sizeof(edvs_file_chunk_header_t), 1, r->fh) == 1
+				&& offset + sizeof(edvs_file_chunk_header_t) + ch.num_bytes <= file_size) {
+				if(r->num_chunks == max_chunks) {
+					max_chunks = (max_chunks == 0) ? 64 : 2*max_chunks;
+					r->chunks = (edvs_file_chunk_t*)realloc(r->chunks, max_chunks*sizeof(edvs_file_chunk_t));
+				}
+				edvs_file_chunk_t* c = r->chunks + r->num_chunks;
+				c->t = ch.t;
+				c->offset = offset;
+				c->n = ch.n;
+				r->num_chunks++;
+				r->header.num_events += ch.n;
+				offset += sizeof(edvs_file_chunk_header_t) + ch.num_bytes;
+			}
 		}
-		else {
-			timestamp = 0;
+		else if(r->header.num_events > 0) {
+			// rebuild index from the first event of each chunk
+			printf("edvs_file_reader_index: file has no index, rebuilding it\n");
+			const uint64_t chunk_size = r->header.chunk_size;
+			const uint64_t n = (r->header.num_events + chunk_size - 1) / chunk_size;
+			r->chunks = (edvs_file_chunk_t*)malloc(n*sizeof(edvs_file_chunk_t));
+			r->num_chunks = n;
+			for(uint64_t i=0; i<n; i++) {
+				edvs_file_chunk_t* c = r->chunks + i;
+				edvs_event_t e;
+				c->offset = r->header.header_size + i*chunk_size*sizeof(edvs_event_t);
+				c->n = (i + 1 < n) ? chunk_size : r->header.num_events - i*chunk_size;
+				if(fseeko(r->fh, c->offset, SEEK_SET) != 0 || edvs_file_read(r->fh, &e, 1) != 1) {
+					printf("edvs_file_reader_index: could not read event\n");
+					r->num_chunks = i;
+					break;
+				}
+				c->t = e.t;
+			}
 		}
-//		printf("%p %zd\n", s, timestamp);
-		// advance byte count
-		i += cNumBytesTimestamp;
-		// compute event time
-// 		if(s->host_timestamp_mode == 2) {
-// 			// compute time since last
-// 			// FIXME this does not assure that timestamps are increasing!!!
-// 			uint64_t dt;
-// 			if(timestamp < s->last_timestamp) {
-// 				// we have a wrap
-// 				dt = cTimestampLimit + timestamp - s->last_timestamp;
-// 			}
-// 			else {
-// 				// we do not have a wrap
-// 				// OR long time no event => ignore
-// 				dt = s->last_timestamp - timestamp;
-// 			}
-// 			s->current_time = system_clock_time + dt;
-// 			s->last_timestamp = timestamp;
-// 			// // OLD
-// 			// if(s->last_timestamp == cTimestampLimit) {
-// 			// // 	// start event time at zero
-// 			// // 	// FIXME this is problematic with multiple event streams
-// 			// // 	//       as they will have different offsets
-// 			// // 	s->last_timestamp = system_clock_time;
-// 			// 	s->last_timestamp = 0; // use system clock time zero point
-// 			// }
-// 			// s->current_time = system_clock_time;
-// 			// s->last_timestamp = system_clock_time;
-// 		}
-// 		else if(s->host_timestamp_mode == 1) {
-// 			if(timestamp_mode != 0) {
-// 				if(s->current_time < 8) { // ignore timestamps of first 8 events
-// 					s->current_time ++;
-// 				}
-// 				else {
-// 					if(s->last_timestamp != cTimestampLimit) {
-// 						// FIXME possible errors for 16 bit timestamps if no event for more than 65 ms
-// 						// FIXME possible errors for 24/32 bit timestamps if timestamp is wrong
-// 						if(timestamp >= s->last_timestamp) {
-// 							s->current_time += (timestamp - s->last_timestamp);
-// 						}
-// 						else {
-// 							// s->current_time += 2 * timestamp;
-// 							s->current_time += timestamp + (cTimestampLimit - s->last_timestamp);
-// 						}
-// 					}
-// 				}
-// 			}
-// //			printf("old=%lu \tnew=%lu \tt=%lu\n", s->last_timestamp, timestamp, s->current_time);
-// 			s->last_timestamp = timestamp;
-// 		}
-// 		else {
-// 			s->current_time = timestamp;
-// 		}
+		fseeko(r->fh, file_position, SEEK_SET);
+	}
+	*num_chunks = r->num_chunks;
+	return r->chunks;
+}
 
-		if(special != 0 && ns != 0 && a == 0 && b == 0) {
-			// create special
-			special_it->t = timestamp; // FIXME s->current_time;
-			special_it->n = special_data_len;
-			// read special data
-#ifdef EDVS_LOG_ULTRA
-			printf("SPECIAL DATA:");
-#endif
-			for(size_t k=0; k<special_it->n; k++) {
-				special_it->data[k] = buffer[i+k];
-#ifdef EDVS_LOG_ULTRA
-				printf(" %d", special_it->data[k]);
-#endif
+int edvs_file_reader_seek(edvs_file_reader_t* r, uint64_t t)
+{
+	if(r->chunks == 0 && r->header.index_offset == 0 && !edvs_file_has_chunk_headers(&r->header)) {
+		// raw file without index: binary search in the file is cheaper than rebuilding the index
+		uint64_t a = 0, b = r->header.num_events;
+		while(a < b) {
+			uint64_t c = a + (b - a)/2;
+			edvs_event_t e;
+			if(edvs_file_reader_set_position(r, c) != 0 || edvs_file_read(r->fh, &e, 1) != 1) {
+				printf("edvs_file_reader_seek: could not read event\n");
+				return -1;
+			}
+			if(e.t < t) {
+				a = c + 1;
+			}
+			else {
+				b = c;
 			}
-#ifdef EDVS_LOG_ULTRA
-			printf("\n");
-#endif
-			i += special_it->n;
-			special_it++;
-			num_special++;
+		}
+		return edvs_file_reader_set_position(r, a);
+	}
+	size_t num_chunks;
+	const edvs_file_chunk_t* chunks = edvs_file_reader_index(r, &num_chunks);
+	// number of chunks which start before t
+	size_t a = 0, b = num_chunks;
+	while(a < b) {
+		size_t c = a + (b - a)/2;
+		if(chunks[c].t < t) {
+			a = c + 1;
 		}
 		else {
-			// create event
-			event_it->t = timestamp;
-			event_it->x = (uint16_t)(b & cLowerBitsMask);
-			event_it->y = (uint16_t)(a & cLowerBitsMask);
-			event_it->parity = ((b & cHighBitMask) ? 1 : 0);
-			event_it->id = 0;
-			event_it++;
+			b = c;
 		}
 	}
-	// i is now the number of processed bytes
-	s->offset = bytes_read - i;
-	if(s->offset > 0) {
-		for(size_t j=0; j<s->offset; j++) {
-			buffer[j] = buffer[i + j];
+	if(a == 0) {
+		return edvs_file_reader_set_position(r, 0);
+	}
+	// the first event >= t is in chunk a-1 or it is the first event of chunk a
+	const edvs_file_chunk_t* c = chunks + (a - 1);
+	const uint64_t first = (a - 1)*(uint64_t)r->header.chunk_size;
+	if(edvs_file_has_chunk_headers(&r->header)) {
+		// search in the decoded chunk
+		if(edvs_file_reader_set_position(r, first) != 0 || edvs_file_reader_load_chunk(r) != 0) {
+			printf("edvs_file_reader_seek: could not read chunk\n");
+			return -1;
+		}
+		size_t i = 0, j = r->num_decoded;
+		while(i < j) {
+			size_t k = i + (j - i)/2;
+			if(r->decoded[k].t < t) {
+				i = k + 1;
+			}
+			else {
+				j = k;
+			}
 		}
+		r->decoded_position = i;
+		r->position = first + i;
+		return 0;
 	}
-	// return
-	if(ns != 0) {
-		if(special != 0) {
-			*ns = special_it - special;
+	edvs_event_t* events = (edvs_event_t*)malloc(c->n*sizeof(edvs_event_t));
+	if(events == 0 || edvs_file_reader_set_position(r, first) != 0
+		|| edvs_file_read(r->fh, events, c->n) != c->n) {
+		printf("edvs_file_reader_seek: could not read chunk\n");
+		free(events);
+		return -1;
+	}
+	size_t i = 0, j = c->n;
+	while(i < j) {
+		size_t k = i + (j - i)/2;
+		if(events[k].t < t) {
+			i = k + 1;
 		}
 		else {
-			*ns = 0;
+			j = k;
 		}
 	}
-	// number of events
-	ssize_t num_events = event_it - events;
-#ifdef EDVS_LOG_ULTRA
-	printf("Parsed %zd events\n", num_events);
-#endif
-	// correct timestamps
-	if(num_events > 0) {
-		uint64_t last_device = s->ts_last_device;
-		uint64_t last_host = s->ts_last_host;
-		if(s->ts_last_host == c_uint64_t_max) {
-			last_device = events->t;
-			last_host = 0;
+	free(events);
+	return edvs_file_reader_set_position(r, first + i);
+}
+
+void edvs_file_reader_close(edvs_file_reader_t* r)
+{
+	if(r->decoder) {
+		edvs_file_decoder_close(r->decoder);
+	}
+	edvs_file_block_free(&r->block);
+	free(r->chunks);
+	free(r);
+}
+
+// ----- ----- ----- ----- ----- ----- ----- ----- ----- //
+
+#include <time.h>
+
+/** Number of events read from an event file at once */
+const size_t cFileStreamBlockSize = 65536;
+
+/** Longest time a realtime file stream sleeps while waiting for the next event */
+const uint64_t cFileStreamMaxSleep = 10000;
+
+/** Reads blocks of events from a file reader on a background thread
+ * Block b is read into slot b % depth. The consumer holds block 'num_consumed'
+ * until it asks for the next one, so the thread reads at most depth - 1 blocks
+ * ahead of the held block.
+ */
+struct edvs_file_prefetch_t {
+	edvs_file_reader_t* reader;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	edvs_event_t* events; // depth slots of block_size events
+	ssize_t* num_events; // number of events per slot, 0 at the end of the file
+	size_t depth;
+	size_t block_size;
+	uint64_t num_produced;
+	uint64_t num_consumed;
+	int is_holding;
+	int stop;
+};
+
+void* edvs_file_prefetch_thread(void* arg)
+{
+	struct edvs_file_prefetch_t* p = (struct edvs_file_prefetch_t*)arg;
+	pthread_mutex_lock(&p->mutex);
+	while(1) {
+		while(!p->stop && p->num_produced - p->num_consumed >= p->depth) {
+			pthread_cond_wait(&p->cond, &p->mutex);
 		}
-//		printf("LAST DEVICE %"PRIu64"\n", last_device);
-//		printf("LAST HOST %"PRIu64"\n", last_host);
-		s->ts_last_device = (events + num_events - 1)->t;
-		if(s->host_timestamp_mode == 1) {
-			compute_timestamps_incremental(events, num_events, last_device, last_host, cTimestampLimit);
+		if(p->stop) {
+			break;
 		}
-		if(s->host_timestamp_mode == 2) {
-			compute_timestamps_systime(events, num_events, last_device, last_host, cTimestampLimit, system_clock_time - s->systime_offset);
+		const size_t k = p->num_produced % p->depth;
+		pthread_mutex_unlock(&p->mutex);
+		// read without holding the lock
+		ssize_t m = edvs_file_reader_read(p->reader, p->events + k*p->block_size, p->block_size);
+		pthread_mutex_lock(&p->mutex);
+		p->num_events[k] = (m > 0) ? m : 0;
+		p->num_produced++;
+		pthread_cond_broadcast(&p->cond);
+		if(m <= 0) {
+			// end of file or error
+			break;
 		}
-		s->ts_last_host = (events + num_events - 1)->t;
 	}
-	return num_events;
+	pthread_mutex_unlock(&p->mutex);
+	return 0;
 }
 
-int edvs_device_streaming_write(edvs_device_streaming_t* s, const char* cmd, size_t n)
+/** Starts reading blocks ahead from the current position of 'reader'
+ * The reader must not be used by the caller until edvs_file_prefetch_close.
+ */
+struct edvs_file_prefetch_t* edvs_file_prefetch_open(edvs_file_reader_t* reader, size_t depth, size_t block_size)
 {
-	if(edvs_device_write(s->device, cmd, n) != n)
-		return -1;
-	return 0;
+	struct edvs_file_prefetch_t* p = (struct edvs_file_prefetch_t*)malloc(sizeof(struct edvs_file_prefetch_t));
+	if(p == 0) {
+		return 0;
+	}
+	p->reader = reader;
+	p->depth = depth;
+	p->block_size = block_size;
+	p->events = (edvs_event_t*)malloc(depth*block_size*sizeof(edvs_event_t));
+	p->num_events = (ssize_t*)calloc(depth, sizeof(ssize_t));
+	if(p->events == 0 || p->num_events == 0) {
+		printf("edvs_file_prefetch_open: out of memory\n");
+		free(p->events);
+		free(p->num_events);
+		free(p);
+		return 0;
+	}
+	p->num_produced = 0;
+	p->num_consumed = 0;
+	p->is_holding = 0;
+	p->stop = 0;
+	pthread_mutex_init(&p->mutex, 0);
+	pthread_cond_init(&p->cond, 0);
+	if(pthread_create(&p->thread, 0, edvs_file_prefetch_thread, p) != 0) {
+		printf("edvs_file_prefetch_open: could not start thread\n");
+		pthread_mutex_destroy(&p->mutex);
+		pthread_cond_destroy(&p->cond);
+		free(p->events);
+		free(p->num_events);
+		free(p);
+		return 0;
+	}
+	return p;
 }
 
-int edvs_device_streaming_stop(edvs_device_streaming_t* s)
+/** Releases the previous block and waits for the next one
+ * The returned block is valid until the next call.
+ * @return number of events in the block, 0 at the end of the file
+ */
+ssize_t edvs_file_prefetch_next(struct edvs_file_prefetch_t* p, edvs_event_t** block)
 {
-	int r = edvs_device_streaming_write(s, "E-\n", 3);
-	if(r != 0) return r;
-	free(s->buffer);
-	free(s);
-	return 0;
+	pthread_mutex_lock(&p->mutex);
+	if(p->is_holding) {
+		p->num_consumed++;
+		p->is_holding = 0;
+		pthread_cond_broadcast(&p->cond);
+	}
+	while(p->num_produced == p->num_consumed) {
+		pthread_cond_wait(&p->cond, &p->mutex);
+	}
+	const size_t k = p->num_consumed % p->depth;
+	const ssize_t n = p->num_events[k];
+	// the block at the end of the file is never released
+	p->is_holding = (n > 0);
+	pthread_mutex_unlock(&p->mutex);
+	*block = p->events + k*p->block_size;
+	return n;
 }
 
-// ----- ----- ----- ----- ----- ----- ----- ----- ----- //
-
-ssize_t edvs_file_read(FILE* fh, edvs_event_t* events, size_t n)
+void edvs_file_prefetch_close(struct edvs_file_prefetch_t* p)
 {
-	return fread((void*)events, sizeof(edvs_event_t), n, fh);
+	pthread_mutex_lock(&p->mutex);
+	p->stop = 1;
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->mutex);
+	pthread_join(p->thread, 0);
+	pthread_mutex_destroy(&p->mutex);
+	pthread_cond_destroy(&p->cond);
+	free(p->events);
+	free(p->num_events);
+	free(p);
 }
 
-ssize_t edvs_file_write(FILE* fh, const edvs_event_t* events, size_t n)
+/** Starts the prefetch thread or falls back to reading on the calling thread */
+int edvs_file_streaming_start_prefetch(edvs_file_streaming_t* s)
 {
-	size_t m = fwrite((const void*)events, sizeof(edvs_event_t), n, fh);
-	if(m != n) {
-		printf("edvs_file_write: could not write to file\n");
-		return -1;
+	s->prefetch = 0;
+	if(s->prefetch_depth > 0) {
+		s->prefetch = edvs_file_prefetch_open(s->reader, s->prefetch_depth, s->num_max);
 	}
-	return m;
+	if(s->prefetch == 0 && s->buffer == 0) {
+		s->buffer = (edvs_event_t*)malloc(s->num_max*sizeof(edvs_event_t));
+		if(s->buffer == 0) {
+			return -1;
+		}
+	}
+	s->unprocessed = s->buffer;
+	return 0;
 }
 
-// ----- ----- ----- ----- ----- ----- ----- ----- ----- //
-
-#include <time.h>
-
-edvs_file_streaming_t* edvs_file_streaming_open(const char* filename, uint64_t dt, float ts)
+edvs_file_streaming_t* edvs_file_streaming_open(const char* filename, uint64_t dt, float ts, size_t prefetch_depth)
 {
 	edvs_file_streaming_t *s = (edvs_file_streaming_t*)malloc(sizeof(edvs_file_streaming_t));
 	if(s == 0) {
 		return 0;
 	}
 	s->fh = fopen(filename, "rb");
+	if(s->fh == 0) {
+		printf("edvs_file_streaming_open: could not open file '%s'\n", filename);
+		free(s);
+		return 0;
+	}
+	s->reader = edvs_file_reader_open(s->fh);
+	if(s->reader == 0) {
+		fclose(s->fh);
+		free(s);
+		return 0;
+	}
 	s->is_eof = 0;
 	s->dt = dt;
 	s->timescale = ts;
-	s->num_max = 1024;
-	s->unprocessed = (edvs_event_t*)malloc(s->num_max*sizeof(edvs_event_t));
-	s->num_curr = 0;
+	s->num_max = cFileStreamBlockSize;
+	s->prefetch_depth = prefetch_depth;
+	s->buffer = 0;
+	if(edvs_file_streaming_start_prefetch(s) != 0) {
+		printf("edvs_file_streaming_open: out of memory\n");
+		edvs_file_reader_close(s->reader);
+		fclose(s->fh);
+		free(s);
+		return 0;
+	}
+	s->begin = 0;
+	s->end = 0;
 	s->is_first = 1;
 	s->start_time = 0;
 	s->start_event_time = 0;
@@ -786,10 +2506,16 @@ edvs_file_streaming_t* edvs_file_streaming_open(const char* filename, uint64_t d
 
 int edvs_file_streaming_run(edvs_file_streaming_t* s)
 {
-	s->start_time = clock();
+	s->start_time = get_micro_time();
 	return 0;
 }
 
+/** Host time in microseconds at which an event is due in realtime playback */
+uint64_t edvs_file_streaming_host_time(const edvs_file_streaming_t* s, uint64_t t)
+{
+	return s->start_time + (uint64_t)((double)(t - s->start_event_time)/(double)s->timescale);
+}
+
 ssize_t edvs_file_streaming_read(edvs_file_streaming_t* s, edvs_event_t* events, size_t events_max)
 {
 	if(s->is_eof) {
@@ -797,58 +2523,101 @@ ssize_t edvs_file_streaming_read(edvs_file_streaming_t* s, edvs_event_t* events,
 	}
 	// get time
 	if(s->dt == 0) {
-		uint64_t nt = ((clock() - s->start_time)*1000000)/CLOCKS_PER_SEC;
-		s->current_event_time = s->start_event_time + (uint64_t)(s->timescale*(float)(nt));
+		uint64_t nt = get_micro_time() - s->start_time;
+		s->current_event_time = s->start_event_time + (uint64_t)((double)s->timescale*(double)nt);
 	}
 	else {
 		s->current_event_time += s->dt;
 	}
 	size_t num_total = 0;
-	do {
-		// read more from stream
-		if(s->num_curr == 0) {
-			s->num_curr = edvs_file_read(s->fh, s->unprocessed, s->num_max);
-			if(s->num_curr == 0) {
+	while(num_total < events_max) {
+		// read the next block from the file
+		if(s->begin == s->end) {
+			ssize_t m = (s->prefetch != 0)
+				? edvs_file_prefetch_next(s->prefetch, &s->unprocessed)
+				: edvs_file_reader_read(s->reader, s->unprocessed, s->num_max);
+			s->begin = 0;
+			s->end = (m > 0) ? m : 0;
+			if(s->end == 0) {
 				s->is_eof = 1;
+				break;
 			}
 		}
 		if(s->is_first) {
-			s->start_event_time = s->unprocessed[0].t;
+			s->start_event_time = s->unprocessed[s->begin].t;
 			s->current_event_time = s->start_event_time;
 			s->is_first = 0;
 		}
-		// find first event with time greater equal to desires time
-		size_t n = 0;
-		//printf("ti=%ld\n",s->unprocessed[n].t);
-		while( n < s->num_curr
-			&& num_total < events_max
-			&& s->unprocessed[n].t < s->current_event_time
-		) {
-			n++;
-			num_total++;
-		}
-		// copy events to output buffer
-		memcpy(
-			(void*)events,
-			(const void*)s->unprocessed,
-			n*sizeof(edvs_event_t));
-		events += n;
-		// move remaining events in unprocessed buffer to start
-		memmove(
-			(void*)s->unprocessed,
-			(const void*)(s->unprocessed + n),
-			(s->num_curr - n)*sizeof(edvs_event_t));
-		s->num_curr -= n;
-	}
-	while(s->num_curr == 0 && s->is_eof != 1);
-	//printf("num_total=%zd\n",num_total);
+		// binary search for the first event with time greater equal to the playback time
+		size_t a = s->begin;
+		size_t b = s->end;
+		if(b - a > events_max - num_total) {
+			b = a + events_max - num_total;
+		}
+		while(a < b) {
+			size_t c = a + (b - a)/2;
+			if(s->unprocessed[c].t < s->current_event_time) {
+				a = c + 1;
+			}
+			else {
+				b = c;
+			}
+		}
+		// copy events to output buffer and advance the read cursor
+		const size_t n = a - s->begin;
+		memcpy(events + num_total, s->unprocessed + s->begin, n*sizeof(edvs_event_t));
+		s->begin += n;
+		num_total += n;
+		if(s->begin < s->end) {
+			// remaining events are later than the playback time
+			break;
+		}
+	}
+	if(num_total == 0 && s->dt == 0 && s->timescale > 0.0f && s->begin < s->end) {
+		// sleep until the next event is due instead of letting the caller spin
+		const uint64_t now = get_micro_time();
+		const uint64_t due = edvs_file_streaming_host_time(s, s->unprocessed[s->begin].t);
+		if(due > now) {
+			const uint64_t d = (due - now < cFileStreamMaxSleep) ? due - now : cFileStreamMaxSleep;
+			struct timespec ts;
+			ts.tv_sec = d / 1000000;
+			ts.tv_nsec = (d % 1000000)*1000;
+			nanosleep(&ts, 0);
+		}
+	}
 	return num_total;
 }
 
+int edvs_file_streaming_seek(edvs_file_streaming_t* s, uint64_t t)
+{
+	// the prefetch thread owns the reader and has read ahead of the old position
+	if(s->prefetch != 0) {
+		edvs_file_prefetch_close(s->prefetch);
+		s->prefetch = 0;
+	}
+	int result = edvs_file_reader_seek(s->reader, t);
+	if(edvs_file_streaming_start_prefetch(s) != 0 || result != 0) {
+		return -1;
+	}
+	// discard buffered events and continue playback at 't'
+	s->begin = 0;
+	s->end = 0;
+	s->is_eof = 0;
+	s->is_first = 0;
+	s->start_time = get_micro_time();
+	s->start_event_time = t;
+	s->current_event_time = t;
+	return 0;
+}
+
 int edvs_file_streaming_stop(edvs_file_streaming_t* s)
 {
+	if(s->prefetch != 0) {
+		edvs_file_prefetch_close(s->prefetch);
+	}
+	edvs_file_reader_close(s->reader);
 	fclose(s->fh);
-	free(s->unprocessed);
+	free(s->buffer);
 	free(s);
 	return 0;
 }
@@ -872,7 +2641,9 @@ int get_uri_type(const char* uri)
 	return 3;
 }
 
-int parse_uri_net(const char* curi, char** ip, int* port, int* dtsm, int* htsm, int* msmode)
+const size_t cDefaultDeviceBufferSize = 65536;
+
+int parse_uri_net(const char* curi, char** ip, int* port, int* dtsm, int* htsm, int* msmode, size_t* buffer_size, int* io_mode)
 {
 	// Example URI:
 	//   192.168.201.62:56001?dtsm=1&htsm=1
@@ -883,6 +2654,8 @@ int parse_uri_net(const char* curi, char** ip, int* port, int* dtsm, int* htsm,
 	*dtsm = 2;
 	*htsm = 1;
 	*msmode = 0;
+	*buffer_size = cDefaultDeviceBufferSize;
+	*io_mode = 0;
 	// local copy of uri
 	char* uri = malloc(strlen(curi)+1);
 	strcpy(uri, curi);
@@ -914,6 +2687,21 @@ int parse_uri_net(const char* curi, char** ip, int* port, int* dtsm, int* htsm,
 		else if(strcmp(token,"msmode")==0) {
 			*msmode = atoi(val);
 		}
+		else if(strcmp(token,"buffer")==0) {
+			*buffer_size = strtoull(val, NULL, 10);
+		}
+		else if(strcmp(token,"io")==0) {
+			if(strcmp(val,"read")==0) {
+				*io_mode = 0;
+			}
+			else if(strcmp(val,"uring")==0) {
+				*io_mode = 1;
+			}
+			else {
+				printf("ERROR in parse_uri: Invalid io mode '%s'!\n", val);
+				return 0;
+			}
+		}
 		else {
 			printf("ERROR in parse_uri_file: Invalid URI token '%s'!\n", token);
 			return 0;
@@ -924,7 +2712,7 @@ int parse_uri_net(const char* curi, char** ip, int* port, int* dtsm, int* htsm,
 	return 1;
 }
 
-int parse_uri_device(const char* curi, char** name, int* baudrate, int* dtsm, int* htsm, int* msmode)
+int parse_uri_device(const char* curi, char** name, int* baudrate, int* dtsm, int* htsm, int* msmode, size_t* buffer_size, int* io_mode)
 {
 	// Example URI:
 	//   /dev/ttyUSB0?baudrate=4000000&dtsm=1&htsm=1
@@ -935,6 +2723,8 @@ int parse_uri_device(const char* curi, char** name, int* baudrate, int* dtsm, in
 	*dtsm = 2;
 	*htsm = 1;
 	*msmode = 0;
+	*buffer_size = cDefaultDeviceBufferSize;
+	*io_mode = 0;
 	// local copy of uri
 	char* uri = malloc(strlen(curi)+1);
 	strcpy(uri, curi);
@@ -963,6 +2753,21 @@ int parse_uri_device(const char* curi, char** name, int* baudrate, int* dtsm, in
 		else if(strcmp(token,"msmode")==0) {
 			*msmode = atoi(val);
 		}
+		else if(strcmp(token,"buffer")==0) {
+			*buffer_size = strtoull(val, NULL, 10);
+		}
+		else if(strcmp(token,"io")==0) {
+			if(strcmp(val,"read")==0) {
+				*io_mode = 0;
+			}
+			else if(strcmp(val,"uring")==0) {
+				*io_mode = 1;
+			}
+			else {
+				printf("ERROR in parse_uri: Invalid io mode '%s'!\n", val);
+				return 0;
+			}
+		}
 		else {
 			printf("ERROR in parse_uri_file: Invalid URI token '%s'!\n", token);
 			return 0;
@@ -973,15 +2778,16 @@ int parse_uri_device(const char* curi, char** name, int* baudrate, int* dtsm, in
 	return 1;
 }
 
-int parse_uri_file(const char* curi, char** fn, uint64_t* dt, float* ts)
+int parse_uri_file(const char* curi, char** fn, uint64_t* dt, float* ts, size_t* prefetch)
 {
 	// Example URI:
-	//   /home/david/data/test.tsv?dt=0&ts=0.1
+	//   /home/david/data/test.tsv?dt=0&ts=0.1&prefetch=4
 
 	// default
 	*fn = NULL;
 	*dt = 0;
 	*ts = 1.0f;
+	*prefetch = 4;
 	// local copy of uri
 	char* uri = malloc(strlen(curi)+1);
 	strcpy(uri, curi);
@@ -1004,6 +2810,9 @@ int parse_uri_file(const char* curi, char** fn, uint64_t* dt, float* ts)
 		else if(strcmp(token,"ts")==0) {
 			*ts = atof(val);
 		}
+		else if(strcmp(token,"prefetch")==0) {
+			*prefetch = atoi(val);
+		}
 		else {
 			printf("ERROR in parse_uri_file: Invalid URI token '%s'!\n", token);
 			return 0;
@@ -1021,7 +2830,9 @@ edvs_stream_handle edvs_open(const char* uri)
 		// parse URI
 		char* ip;
 		int port, dtsm, htsm, msmode;
-		if(parse_uri_net(uri, &ip, &port, &dtsm, &htsm, &msmode) == 0) {
+		int io_mode;
+		size_t buffer_size;
+		if(parse_uri_net(uri, &ip, &port, &dtsm, &htsm, &msmode, &buffer_size, &io_mode) == 0) {
 			printf("edvs_open: Failed to parse URI\n");
 			free(ip);
 			return 0;
@@ -1039,7 +2850,7 @@ edvs_stream_handle edvs_open(const char* uri)
 		edvs_device_t* dh = (edvs_device_t*)malloc(sizeof(edvs_device_t));
 		dh->type = EDVS_NETWORK_DEVICE;
 		dh->handle = dev;
-		edvs_device_streaming_t* ds = edvs_device_streaming_open(dh, dtsm, htsm, msmode);
+		edvs_device_streaming_t* ds = edvs_device_streaming_open(dh, dtsm, htsm, msmode, buffer_size, io_mode);
 		struct edvs_stream_t* s = (struct edvs_stream_t*)malloc(sizeof(struct edvs_stream_t));
 		s->type = EDVS_DEVICE_STREAM;
 		s->handle = (uintptr_t)ds;
@@ -1049,7 +2860,9 @@ edvs_stream_handle edvs_open(const char* uri)
 		// parse URI
 		char* port;
 		int baudrate, dtsm, htsm, msmode;
-		if(parse_uri_device(uri, &port, &baudrate, &dtsm, &htsm, &msmode) == 0) {
+		int io_mode;
+		size_t buffer_size;
+		if(parse_uri_device(uri, &port, &baudrate, &dtsm, &htsm, &msmode, &buffer_size, &io_mode) == 0) {
 			printf("edvs_open: Failed to parse URI\n");
 			free(port);
 			return 0;
@@ -1067,7 +2880,7 @@ edvs_stream_handle edvs_open(const char* uri)
 		edvs_device_t* dh = (edvs_device_t*)malloc(sizeof(edvs_device_t));
 		dh->type = EDVS_SERIAL_DEVICE;
 		dh->handle = dev;
-		edvs_device_streaming_t* ds = edvs_device_streaming_open(dh, dtsm, htsm, msmode);
+		edvs_device_streaming_t* ds = edvs_device_streaming_open(dh, dtsm, htsm, msmode, buffer_size, io_mode);
 		struct edvs_stream_t* s = (struct edvs_stream_t*)malloc(sizeof(struct edvs_stream_t));
 		s->type = EDVS_DEVICE_STREAM;
 		s->handle = (uintptr_t)ds;
@@ -1079,15 +2892,19 @@ edvs_stream_handle edvs_open(const char* uri)
 		char* fn;
 		uint64_t dt;
 		float ts;
-		if(parse_uri_file(uri, &fn, &dt, &ts) == 0) {
+		size_t prefetch;
+		if(parse_uri_file(uri, &fn, &dt, &ts, &prefetch) == 0) {
 			printf("edvs_open: Failed to parse URI\n");
 			free(fn);
 			return 0;
 		}
 		// open
-		printf("Opening event file '%s' using dt=%lu, ts=%f\n", fn, dt, ts);
-		edvs_file_streaming_t* ds = edvs_file_streaming_open(fn, dt, ts);
+		printf("Opening event file '%s' using dt=%lu, ts=%f, prefetch=%zu\n", fn, dt, ts, prefetch);
+		edvs_file_streaming_t* ds = edvs_file_streaming_open(fn, dt, ts, prefetch);
 		free(fn);
+		if(ds == 0) {
+			return 0;
+		}
 		struct edvs_stream_t* s = (struct edvs_stream_t*)malloc(sizeof(struct edvs_stream_t));
 		s->type = EDVS_FILE_STREAM;
 		s->handle = (uintptr_t)ds;
@@ -1208,4 +3025,51 @@ ssize_t edvs_write(edvs_stream_handle s, const char* cmd, size_t n)
 	return -1;
 }
 
+int edvs_file_seek(edvs_stream_handle s, uint64_t t)
+{
+	if(s->type == EDVS_FILE_STREAM) {
+		edvs_file_streaming_t* ds = (edvs_file_streaming_t*)s->handle;
+		return edvs_file_streaming_seek(ds, t);
+	}
+	printf("edvs_file_seek: only possible for file streams\n");
+	return -1;
+}
+
+int edvs_get_fd(edvs_stream_handle s)
+{
+	if(s->type == EDVS_DEVICE_STREAM) {
+		edvs_device_streaming_t* ds = (edvs_device_streaming_t*)s->handle;
+		if(ds->uring) {
+			// readable when the pending read has completed
+			return edvs_uring_get_fd(ds->uring);
+		}
+		return ds->device->handle;
+	}
+	return -1;
+}
+
+ssize_t edvs_fill(edvs_stream_handle s)
+{
+	if(s->type == EDVS_DEVICE_STREAM) {
+		edvs_device_streaming_t* ds = (edvs_device_streaming_t*)s->handle;
+		return edvs_device_streaming_fill(ds);
+	}
+	printf("edvs_fill: only possible for device streams\n");
+	return -1;
+}
+
+ssize_t edvs_read_buffered(edvs_stream_handle s, edvs_event_t* events, size_t n)
+{
+	if(s->type == EDVS_DEVICE_STREAM) {
+		edvs_device_streaming_t* ds = (edvs_device_streaming_t*)s->handle;
+		uint64_t system_clock_time = 0;
+		if(ds->host_timestamp_mode == 2) {
+			system_clock_time = get_micro_time();
+		}
+		return edvs_device_streaming_parse(ds, events, n, 0, 0, system_clock_time);
+	}
+	printf("edvs_read_buffered: only possible for device streams\n");
+	return -1;
+}
+
 // ----- ----- ----- ----- ----- ----- ----- ----- ----- //
@@ -69,12 +69,204 @@ ssize_t edvs_read_ext(edvs_stream_handle h, edvs_event_t* events, size_t n, edvs
 
 ssize_t edvs_write(edvs_stream_handle h, const char* cmd, size_t n);
 
+/** Moves a file stream to the first event with timestamp greater or equal to 't'
+ * Buffered events are discarded and playback continues at time 't'. Only
+ * the events of one chunk are read (see event file container below).
+ * @return 0 on success, negative value on error or for live streams
+ */
+int edvs_file_seek(edvs_stream_handle h, uint64_t t);
+
+/** File descriptor of a device stream (serial port or network socket)
+ * Can be used to wait for data with select/poll/epoll. For io=uring this is
+ * the io_uring file descriptor which is readable when a read has completed.
+ * Returns -1 for file streams.
+ */
+int edvs_get_fd(edvs_stream_handle h);
+
+/** Reads available bytes from a device stream into its internal buffer
+ * Blocks if no data is available, so only call when the fd is readable.
+ * @return number of bytes read, 0 if the connection was closed or the
+ *			buffer is full, negative value on error
+ */
+ssize_t edvs_fill(edvs_stream_handle h);
+
+/** Parses events from bytes in the internal buffer of a device stream (does not block) */
+ssize_t edvs_read_buffered(edvs_stream_handle h, edvs_event_t* events, size_t n);
+
 /** Reads events from a file */
 ssize_t edvs_file_read(FILE* fh, edvs_event_t* events, size_t n);
 
 /** Writes events to a file */
 ssize_t edvs_file_write(FILE* fh, const edvs_event_t* events, size_t n);
 
+/** *** Event file container ***
+ * Layout (little endian):
+ *		header (edvs_file_header_t, 'header_size' bytes)
+ *		events in chunks of 'chunk_size' events (only the last chunk can be smaller)
+ *		index: uint64_t number of chunks followed by one edvs_file_chunk_t per chunk
+ * The index is written when the file is closed. If 'index_offset' is 0 the
+ * recording was not closed properly and the index is rebuilt from the events.
+ * Files without the magic are read as plain arrays of edvs_event_t.
+ *
+ * Chunk layout depends on encoding and compression:
+ *		raw, not compressed: array of edvs_event_t
+ *		otherwise: edvs_file_chunk_header_t followed by 'num_bytes' bytes with
+ *			the encoded events (see edvs_delta_encode), compressed as a whole
+ */
+
+#define EDVS_FILE_MAGIC "EDVSFILE"
+#define EDVS_FILE_VERSION 2
+#define EDVS_FILE_MAX_SENSORS 256
+#define EDVS_FILE_DEFAULT_CHUNK_SIZE 65536
+
+/** Encoding of events in an event file */
+typedef enum {
+	EDVS_ENCODING_RAW = 0, // array of edvs_event_t
+	EDVS_ENCODING_DELTA = 1 // variable length, typically 3 to 5 bytes per event
+} edvs_file_encoding_t;
+
+/** Compression of chunks in an event file (version 2) */
+typedef enum {
+	EDVS_COMPRESSION_NONE = 0,
+	EDVS_COMPRESSION_ZLIB = 1,
+	EDVS_COMPRESSION_ZSTD = 2
+} edvs_file_compression_t;
+
+/** Returns 1 if libEdvs was built with support for a compression */
+int edvs_file_compression_supported(uint32_t compression);
+
+/** Header of an event file (320 bytes) */
+typedef struct {
+	char magic[8]; // EDVS_FILE_MAGIC without terminating zero
+	uint32_t version; // 0 for files without header
+	uint32_t header_size; // offset of the first chunk
+	uint32_t encoding; // see edvs_file_encoding_t
+	uint32_t chunk_size; // events per chunk
+	uint16_t width, height; // sensor resolution
+	uint32_t time_unit_ns; // duration of one timestamp tick in nanoseconds
+	uint64_t start_time; // host time of timestamp 0 in microseconds since epoch (0 if unknown)
+	uint64_t num_events;
+	uint64_t index_offset; // 0 if there is no index
+	uint32_t num_sensors;
+	uint32_t compression; // see edvs_file_compression_t
+	uint8_t sensor_ids[EDVS_FILE_MAX_SENSORS];
+} edvs_file_header_t;
+
+/** Index entry for one chunk */
+typedef struct {
+	uint64_t t; // timestamp of first event
+	uint64_t offset; // byte offset in file
+	uint64_t n; // number of events
+} edvs_file_chunk_t;
+
+/** Header in front of each chunk of a delta encoded file */
+typedef struct {
+	uint64_t t; // timestamp of first event
+	uint32_t n; // number of events
+	uint32_t num_bytes; // size of the encoded and compressed events
+} edvs_file_chunk_header_t;
+
+/** Maximum number of bytes of one delta encoded event */
+#define EDVS_DELTA_MAX_EVENT_BYTES 20
+
+/** Delta encodes events
+ * Each event is stored as
+ *		varint: zigzag encoded difference to the timestamp of the previous event
+ *		uint16: x | y << 7 | parity << 14 | extended << 15
+ *		if extended:
+ *			varint: id | large << 8
+ *			if large: uint16 x, uint16 y, uint8 parity
+ * 'extended' is set if the id differs from the previous event and
+ * 'large' is set if x or y do not fit into 7 bits or parity is not 0 or 1.
+ * A chunk starts with timestamp and id of the previous event set to the
+ * timestamp of the first event and 0.
+ * @param t,id timestamp and id of the previous event, updated to the last event
+ * @param data at least n*EDVS_DELTA_MAX_EVENT_BYTES bytes
+ * @return number of bytes written
+ */
+size_t edvs_delta_encode(const edvs_event_t* events, size_t n, uint64_t* t, uint8_t* id, unsigned char* data);
+
+/** Decodes 'n' delta encoded events starting with timestamp 't0' and id 0
+ * 'data' must be readable for EDVS_DELTA_MAX_EVENT_BYTES bytes after 'num_bytes'.
+ * @return number of bytes used or -1 if the data is corrupt
+ */
+ssize_t edvs_delta_decode(const unsigned char* data, size_t num_bytes, uint64_t t0, edvs_event_t* events, size_t n);
+
+/** Sets default values: 128x128 sensor, microsecond timestamps, raw encoding, no compression, no sensors */
+void edvs_file_header_init(edvs_file_header_t* header);
+
+/** Writes events to a file with header and chunk index */
+typedef struct {
+	FILE* fh;
+	edvs_file_header_t header;
+	edvs_file_chunk_t* chunks;
+	size_t num_chunks;
+	size_t max_chunks;
+	uint64_t num_in_chunk;
+	uint64_t offset;
+	// chunks with header: current chunk is encoded in memory and written when it is full
+	unsigned char* data;
+	size_t num_bytes;
+	unsigned char* compressed;
+	size_t compressed_size;
+	uint64_t last_t;
+	uint8_t last_id;
+} edvs_file_writer_t;
+
+/** Starts writing a file, writes the header (the file is not closed by the writer) */
+edvs_file_writer_t* edvs_file_writer_open(FILE* fh, const edvs_file_header_t* header);
+
+ssize_t edvs_file_writer_write(edvs_file_writer_t* w, const edvs_event_t* events, size_t n);
+
+/** Writes the index, updates the header and frees the writer */
+int edvs_file_writer_close(edvs_file_writer_t* w);
+
+/** Buffers for reading and decoding one chunk */
+typedef struct {
+	edvs_file_chunk_header_t header;
+	unsigned char* data; // stored bytes with zero padding
+	size_t data_size;
+	unsigned char* buffer; // decompressed bytes
+	size_t buffer_size;
+	edvs_event_t* events; // 'chunk_size' decoded events
+} edvs_file_block_t;
+
+struct edvs_file_decoder_t;
+
+/** Reads events from a file with header or from a plain event file */
+typedef struct {
+	FILE* fh;
+	edvs_file_header_t header;
+	edvs_file_chunk_t* chunks; // loaded on demand
+	size_t num_chunks;
+	uint64_t position; // index of next event
+	// chunks with header: decoded events of the current chunk
+	edvs_event_t* decoded;
+	size_t num_decoded;
+	size_t decoded_position;
+	uint64_t chunk; // number of the next chunk
+	edvs_file_block_t block; // used if chunks are read on the calling thread
+	struct edvs_file_decoder_t* decoder; // decompresses chunks ahead on worker threads
+} edvs_file_reader_t;
+
+/** Starts reading a file and reads the header (the file is not closed by the reader)
+ * Compressed chunks are read and decompressed ahead on a pool of worker threads.
+ */
+edvs_file_reader_t* edvs_file_reader_open(FILE* fh);
+
+ssize_t edvs_file_reader_read(edvs_file_reader_t* r, edvs_event_t* events, size_t n);
+
+/** Moves to the first event with timestamp greater or equal to 't'
+ * Uses the chunk index, so only one chunk is read.
+ * Events must be ordered by timestamp.
+ */
+int edvs_file_reader_seek(edvs_file_reader_t* r, uint64_t t);
+
+/** Chunk index of the file (rebuilt if not stored in the file) */
+const edvs_file_chunk_t* edvs_file_reader_index(edvs_file_reader_t* r, size_t* num_chunks);
+
+void edvs_file_reader_close(edvs_file_reader_t* r);
+
 #ifdef __cplusplus
 }
 #endif
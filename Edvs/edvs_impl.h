@@ -2,6 +2,7 @@
 #define INCLUDED_EDVS_IMPL_H
 
 #include "event.h"
+#include "edvs.h"
 #include <stddef.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -104,15 +105,54 @@ int edvs_device_write_str(edvs_device_t* dh, const char* str);
 int edvs_device_close(edvs_device_t* dh);
 
 
+/** Circular byte buffer for raw device data
+ * If possible the memory is mapped twice back to back, so the unparsed and the
+ * free region are always contiguous and no bytes have to be moved. Otherwise
+ * a linear buffer is used and the unparsed rest is moved to the front.
+ */
+typedef struct {
+	unsigned char* data;
+	size_t length;
+	size_t begin; // read position (free running)
+	size_t end; // write position (free running)
+	int is_mirrored;
+} edvs_byte_ring_t;
+
+/** Allocates a buffer with at least 'length' bytes (rounded up to page size) */
+int edvs_byte_ring_init(edvs_byte_ring_t* r, size_t length);
+
+void edvs_byte_ring_free(edvs_byte_ring_t* r);
+
+/** Number of unparsed bytes */
+size_t edvs_byte_ring_size(const edvs_byte_ring_t* r);
+
+/** Contiguous free region, 'n' is set to its size. Advance 'end' after writing. */
+unsigned char* edvs_byte_ring_write_ptr(edvs_byte_ring_t* r, size_t* n);
+
+/** Contiguous unparsed region, 'n' is set to its size */
+const unsigned char* edvs_byte_ring_read_ptr(const edvs_byte_ring_t* r, size_t* n);
+
+/** Marks 'n' bytes as parsed */
+void edvs_byte_ring_consume(edvs_byte_ring_t* r, size_t n);
+
+/** io_uring state of a device (see edvs_uring_open) */
+struct edvs_uring_t;
+
+/** Sets up an io_uring for reading from 'fd' into 'buffer' (registered if possible)
+ * Returns 0 if io_uring is not available.
+ */
+struct edvs_uring_t* edvs_uring_open(int fd, void* buffer, size_t length);
+
+void edvs_uring_close(struct edvs_uring_t* u);
+
 /** Device streaming parameters and state */
 typedef struct {
 	edvs_device_t* device;
 	int device_timestamp_mode;
 	int host_timestamp_mode;
 	int master_slave_mode;
-	unsigned char* buffer;
-	size_t length;
-	size_t offset;
+	edvs_byte_ring_t ring;
+	struct edvs_uring_t* uring; // 0 if normal reads are used
 //	uint64_t current_time;
 //	uint64_t last_timestamp;
 	uint64_t ts_last_device;
@@ -122,14 +162,18 @@ typedef struct {
 
 typedef struct {
 	FILE* fh;
+	edvs_file_reader_t* reader;
 	int is_eof;
 	uint64_t dt; // 0=realtime, else use dt to increase time each call to read
 	float timescale; // used to replay slowed down
-	edvs_event_t* unprocessed;
+	edvs_event_t* unprocessed; // current block of events read from the file
+	edvs_event_t* buffer; // block buffer if there is no prefetch thread
 	size_t num_max;
-	size_t num_curr;
+	size_t prefetch_depth; // number of blocks read ahead, 0 to read on the calling thread
+	struct edvs_file_prefetch_t* prefetch;
+	size_t begin, end; // events [begin, end[ of the block were not returned yet
 	int is_first;
-	clock_t start_time;
+	uint64_t start_time; // monotonic host time in microseconds when playback started
 	uint64_t start_event_time;
 	uint64_t current_event_time;
 } edvs_file_streaming_t;
@@ -139,10 +183,39 @@ typedef struct {
  * device_tsm: 0: none, 1: 16 bit, 2: 24 bit, 3: 32 bit
  * host_tsm: 0: raw device, 1: unwrap, 2: with system time
  * master_slave_mode: 0: disabled, 1: master, 2: slave
+ * buffer_size: size of the raw byte buffer
+ * io_mode: 0: read, 1: io_uring (one read is always pending)
+ */
+edvs_device_streaming_t* edvs_device_streaming_open(edvs_device_t* dh, int device_tsm, int host_tsm, int master_slave_mode, size_t buffer_size, int io_mode);
+
+/** Parses raw device bytes into events and special data
+ * Uses SIMD instructions (SSE2/AVX2) to validate runs of regular events.
+ * Incomplete events at the end of the data are not consumed.
+ * @param device_tsm device timestamp mode (0 = none, 1 = 16 bit, 2 = 24 bit, 3 = 32 bit)
+ * @param num_events in: capacity of 'events', out: number of parsed events
+ * @param ns in: capacity of 'special', out: number of parsed special data blocks
+ * @return number of consumed bytes
+ */
+size_t edvs_parse_events(const unsigned char* data, size_t num_bytes, int device_tsm,
+	edvs_event_t* events, size_t* num_events, edvs_special_t* special, size_t* ns);
+
+/** Same as edvs_parse_events but checks every single event (reference implementation) */
+size_t edvs_parse_events_careful(const unsigned char* data, size_t num_bytes, int device_tsm,
+	edvs_event_t* events, size_t* num_events, edvs_special_t* special, size_t* ns);
+
+/** Reads as many bytes from the device as fit into the buffer (may block)
+ * @return number of bytes read or -1 on error
+ */
+ssize_t edvs_device_streaming_fill(edvs_device_streaming_t* s);
+
+/** Parses up to 'n' events from buffered bytes (does not block)
+ * system_clock_time: current time for host_tsm=2
  */
-edvs_device_streaming_t* edvs_device_streaming_start(edvs_device_t* dh, int device_tsm, int host_tsm, int master_slave_mode);
+size_t edvs_device_streaming_parse(edvs_device_streaming_t* s, edvs_event_t* events, size_t n, edvs_special_t* special, size_t* ns, uint64_t system_clock_time);
 
-/** Reads events from an edvs device */
+/** Reads events from an edvs device
+ * Only reads from the device if no buffered event could be parsed.
+ */
 ssize_t edvs_device_streaming_read(edvs_device_streaming_t* s, edvs_event_t* events, size_t n, edvs_special_t* special, size_t* ns);
 
 int edvs_device_streaming_write(edvs_device_streaming_t* s, const char* cmd, size_t n);
@@ -168,13 +241,20 @@ ssize_t edvs_file_write(FILE* fh, const edvs_event_t* events, size_t n);
  * @param filename
  * @param dt see description
  * @param ts scales time for faster or slower playback
+ * @param prefetch_depth number of blocks a background thread reads ahead
+ * 			of playback, 0 reads on the calling thread
  * @return handle 
  */
-edvs_file_streaming_t* edvs_file_streaming_start(const char* filename, uint64_t dt, float ts);
+edvs_file_streaming_t* edvs_file_streaming_open(const char* filename, uint64_t dt, float ts, size_t prefetch_depth);
 
 /** Reads events from the event file stream */
 ssize_t edvs_file_streaming_read(edvs_file_streaming_t* s, edvs_event_t* events, size_t events_max);
 
+/** Moves playback to the first event with timestamp greater or equal to 't'
+ * Uses the chunk index of the file, so the events before 't' are not read.
+ */
+int edvs_file_streaming_seek(edvs_file_streaming_t* s, uint64_t t);
+
 /** Stops streaming from an event file */
 int edvs_file_streaming_stop(edvs_file_streaming_t* s);
 
@@ -9,7 +9,7 @@ extern "C" {
 #endif
 
 /** An edvs event
- * Struct uses 14 bytes of data.
+ * Struct uses 14 bytes of data and 16 bytes with padding.
  */
 typedef struct {
 	uint64_t t;
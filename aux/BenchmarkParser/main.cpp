@@ -0,0 +1,146 @@
+#include <Edvs/edvs_impl.h>
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstring>
+
+typedef size_t (*parse_f)(const unsigned char*, size_t, int, edvs_event_t*, size_t*, edvs_special_t*, size_t*);
+
+/** Creates raw device data for 'n' random events
+ * With probability 'error_rate' a byte is dropped to simulate transmission errors.
+ */
+std::vector<unsigned char> CreateData(size_t n, int dtsm, double error_rate)
+{
+	const unsigned int num_bytes_timestamp = (dtsm == 0) ? 0 : (dtsm + 1);
+	std::mt19937 rnd(42);
+	std::uniform_int_distribution<int> dist(0, 127);
+	std::uniform_real_distribution<double> dist_error(0.0, 1.0);
+	std::vector<unsigned char> data;
+	data.reserve(n*(2 + num_bytes_timestamp));
+	uint64_t t = 0;
+	for(size_t i=0; i<n; i++) {
+		t += dist(rnd);
+		unsigned char buf[6];
+		buf[0] = 0x80 | dist(rnd);
+		buf[1] = ((dist(rnd) & 1) << 7) | dist(rnd);
+		for(unsigned int k=0; k<num_bytes_timestamp; k++) {
+			buf[2 + k] = (t >> (8*(num_bytes_timestamp - 1 - k))) & 0xFF;
+		}
+		for(unsigned int k=0; k<2 + num_bytes_timestamp; k++) {
+			if(error_rate > 0.0 && dist_error(rnd) < error_rate) {
+				continue;
+			}
+			data.push_back(buf[k]);
+		}
+	}
+	return data;
+}
+
+/** Parses data in chunks like edvs_device_streaming_read does
+ * 'events' must be large enough to hold all events.
+ * @return number of parsed events
+ */
+size_t Parse(parse_f parse, const std::vector<unsigned char>& data, int dtsm, size_t chunk_size, std::vector<edvs_event_t>& events)
+{
+	std::vector<unsigned char> buffer(chunk_size);
+	size_t num_events = 0;
+	size_t offset = 0;
+	size_t pos = 0;
+	while(pos < data.size()) {
+		const size_t num_read = std::min(chunk_size - offset, data.size() - pos);
+		std::memcpy(buffer.data() + offset, data.data() + pos, num_read);
+		pos += num_read;
+		const size_t num_bytes = offset + num_read;
+		size_t n = events.size() - num_events;
+		const size_t i = parse(buffer.data(), num_bytes, dtsm, events.data() + num_events, &n, 0, 0);
+		num_events += n;
+		offset = num_bytes - i;
+		std::memmove(buffer.data(), buffer.data() + i, offset);
+	}
+	return num_events;
+}
+
+bool operator==(const edvs_event_t& a, const edvs_event_t& b)
+{
+	return a.t == b.t && a.x == b.x && a.y == b.y && a.parity == b.parity && a.id == b.id;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string p_fn = "";
+	int p_dtsm = 2;
+	size_t p_num = 10000000;
+	size_t p_chunk = 8192;
+	double p_error_rate = 0.0;
+	unsigned int p_repeat = 5;
+
+	namespace po = boost::program_options;
+	// Declare the supported options.
+	po::options_description desc("Allowed options");
+	desc.add_options()
+		("help", "produce help message")
+		("fn", po::value(&p_fn), "raw byte dump recorded from a device (random data if not set)")
+		("dtsm", po::value(&p_dtsm)->default_value(p_dtsm), "device timestamp mode (0-3)")
+		("num", po::value(&p_num)->default_value(p_num), "number of random events")
+		("chunk", po::value(&p_chunk)->default_value(p_chunk), "number of bytes parsed per call")
+		("error-rate", po::value(&p_error_rate)->default_value(p_error_rate), "probability that a random byte is dropped")
+		("repeat", po::value(&p_repeat)->default_value(p_repeat), "number of runs per parser")
+	;
+
+	po::variables_map vm;
+	po::store(po::parse_command_line(argc, argv, desc), vm);
+	po::notify(vm);
+
+	if(vm.count("help")) {
+		std::cout << desc << std::endl;
+		return 1;
+	}
+
+	std::vector<unsigned char> data;
+	if(p_fn.empty()) {
+		data = CreateData(p_num, p_dtsm, p_error_rate);
+	}
+	else {
+		std::ifstream ifs(p_fn, std::ios::binary);
+		if(!ifs.is_open()) {
+			std::cerr << "Could not open file '" << p_fn << "'" << std::endl;
+			return 0;
+		}
+		data.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+	}
+	std::cout << "Parsing " << data.size() << " bytes in chunks of " << p_chunk << " bytes" << std::endl;
+
+	std::vector<edvs_event_t> results[2];
+	const parse_f parsers[2] = { &edvs_parse_events_careful, &edvs_parse_events };
+	const char* names[2] = { "careful", "fast" };
+	for(int k=0; k<2; k++) {
+		// allocate (and touch) the output before measuring
+		results[k].assign(data.size()/2 + 1, edvs_event_t());
+		size_t num_events = 0;
+		double best = 0.0;
+		for(unsigned int r=0; r<p_repeat; r++) {
+			auto t0 = std::chrono::high_resolution_clock::now();
+			num_events = Parse(parsers[k], data, p_dtsm, p_chunk, results[k]);
+			auto t1 = std::chrono::high_resolution_clock::now();
+			const double dt = std::chrono::duration<double>(t1 - t0).count();
+			if(r == 0 || dt < best) {
+				best = dt;
+			}
+		}
+		results[k].resize(num_events);
+		std::cout << names[k] << ": " << num_events << " events, "
+			<< double(data.size())/best/1000000.0 << " MB/s, "
+			<< double(num_events)/best/1000000.0 << " M events/s" << std::endl;
+	}
+
+	if(results[0] != results[1]) {
+		std::cerr << "ERROR: parsers disagree!" << std::endl;
+		return 0;
+	}
+	std::cout << "Parsers agree" << std::endl;
+	return 1;
+}
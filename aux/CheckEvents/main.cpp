@@ -5,7 +5,9 @@
  *      Author: david
  */
 
+#include <Edvs/EventFileView.hpp>
 #include <Edvs/EventIO.hpp>
+#include <Edvs/EventBatchSoA.hpp>
 #include <boost/program_options.hpp>
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics/stats.hpp>
@@ -13,8 +15,50 @@
 #include <boost/accumulators/statistics/variance.hpp>
 #include <boost/accumulators/statistics/p_square_cumulative_distribution.hpp>
 #include <boost/range/iterator_range.hpp>
+#include <array>
+#include <functional>
 #include <string>
 #include <vector>
+#include <stdio.h>
+
+/** Calls 'f' for consecutive blocks of at most 'block_size' events of a file
+ * Raw files are mapped. Delta encoded and compressed files can not be mapped
+ * and are decoded block by block instead. Memory use is bounded in both cases.
+ * @return false if the file could not be read
+ */
+bool ForEachBlock(const std::string& fn, std::size_t block_size, const std::function<void(const Edvs::Event*, std::size_t)>& f)
+{
+	Edvs::EventFileHeader header;
+	if(!Edvs::LoadEventFileHeader(fn, header)) {
+		return false;
+	}
+	if(Edvs::IsMappable(header)) {
+		Edvs::EventFileView events(fn);
+		if(!events.is_open()) {
+			return false;
+		}
+		for(std::size_t offset=0; offset<events.size(); offset+=block_size) {
+			f(events.data() + offset, std::min(block_size, events.size() - offset));
+		}
+		return true;
+	}
+	FILE* fh = fopen(fn.c_str(), "r");
+	if(fh == 0) {
+		std::cerr << "Error opening file '" << fn << "'!" << std::endl;
+		return false;
+	}
+	edvs_file_reader_t* r = edvs_file_reader_open(fh);
+	if(r) {
+		std::vector<Edvs::Event> block(block_size);
+		ssize_t n;
+		while((n = edvs_file_reader_read(r, block.data(), block.size())) > 0) {
+			f(block.data(), n);
+		}
+		edvs_file_reader_close(r);
+	}
+	fclose(fh);
+	return r != 0;
+}
 
 int main(int argc, char** argv)
 {
@@ -44,65 +88,108 @@ int main(int argc, char** argv)
 
 	for(const std::string& fn : fns) {
 
-		std::cout << "Loading events from file '" << fn << "'..." << std::flush;
-		std::vector<Edvs::Event> events = Edvs::LoadEvents(fn);
-		std::cout << " done." << std::endl;
+		typedef acc::accumulator_set<uint64_t, acc::stats<
+				acc::tag::mean
+				,acc::tag::variance
+				,acc::tag::p_square_cumulative_distribution
+				>> accumulator_t;
+		accumulator_t a(acc::tag::p_square_cumulative_distribution::num_cells = 5);
+
+		// events are read block by block and timestamps are transposed, so the
+		// scans below read only 8 bytes per event and memory use stays bounded
+		const std::size_t block_size = 1 << 20;
+		Edvs::EventBatchSoA batch;
+		uint64_t num_events = 0;
+		uint64_t first_t = 0;
+		uint64_t last_t = 0;
+		std::vector<uint64_t> first_ts;
+		// event index and timestamps before and after for jumps and unordered timestamps
+		// only the first problems are kept, so a corrupted file does not fill the memory
+		const std::size_t max_listed = 1000;
+		std::vector<std::array<uint64_t,3>> jumps, order;
+		uint64_t num_jumps = 0;
+		uint64_t num_order = 0;
+		const bool ok = ForEachBlock(fn, block_size, [&](const Edvs::Event* events, std::size_t n) {
+			const uint64_t offset = num_events;
+			if(offset == 0) {
+				first_t = events[0].t;
+				last_t = first_t;
+			}
+			batch.assign(events, n);
+			const uint64_t* ts = batch.t.data();
+			for(std::size_t i=0; i<n && first_ts.size()<10; i++) {
+				first_ts.push_back(ts[i]);
+			}
+			// jumps
+			int64_t last_jump_t = last_t;
+			for(std::size_t i=0; i<n; i++) {
+				int64_t t = ts[i];
+				if(std::abs(t - last_jump_t) > 1000000) {
+					if(jumps.size() < max_listed) {
+						jumps.push_back({{offset + i, static_cast<uint64_t>(last_jump_t), static_cast<uint64_t>(t)}});
+					}
+					num_jumps++;
+				}
+				last_jump_t = t;
+			}
+			// timestamp order
+			uint64_t last_order_t = last_t;
+			for(std::size_t i=0; i<n; i++) {
+				uint64_t t = ts[i];
+				if(t < last_order_t) {
+					if(order.size() < max_listed) {
+						order.push_back({{offset + i, last_order_t, t}});
+					}
+					num_order++;
+				}
+				last_order_t = t;
+			}
+			// statistics
+			uint64_t t1 = last_t;
+			for(std::size_t i=0; i<n; i++) {
+				uint64_t t2 = ts[i];
+				if(t1 < t2) {
+					a(t2 - t1);
+				}
+				t1 = t2;
+			}
+			last_t = ts[n - 1];
+			num_events += n;
+		});
+		if(!ok) {
+			continue;
+		}
+
+		std::cout << "Number of events: " << num_events << std::endl;
 
-		std::cout << "Number of events: " << events.size() << std::endl;
-		
-		if(events.size() > 0) {
-			std::cout << "Timespan: [" << events.front().t << "," << events.back().t << "]" << std::endl;
+		if(num_events == 0) {
+			continue;
 		}
+		std::cout << "Timespan: [" << first_t << "," << last_t << "]" << std::endl;
 		std::cout << "First 10 timestamps:" << std::endl;
-		for(unsigned i=0; i<std::min<unsigned>(10,events.size()); i++) {
-			std::cout << "\t" << events[i].t << std::endl;
+		for(uint64_t t : first_ts) {
+			std::cout << "\t" << t << std::endl;
 		}
 
-		{
-			std::cout << "JUMPS" << std::endl;
-			int64_t last_t = events.front().t;
-			for(std::size_t i=0; i<events.size(); i++) {
-				int64_t t = events[i].t;
-				//if(t - last_t > 1000) std::cout << "t=" << t << ", dt=" << t - last_t << std::endl;
-				if(std::abs(t - last_t) > 1000000) {
-					std::cout << "\tevent " << i << ": " << last_t << " -> " << t << std::endl;
-				}
-				last_t = t;
-			}
-			std::cout << std::endl;
+		std::cout << "JUMPS" << std::endl;
+		for(const auto& u : jumps) {
+			std::cout << "\tevent " << u[0] << ": " << u[1] << " -> " << u[2] << std::endl;
+		}
+		if(num_jumps > jumps.size()) {
+			std::cout << "\t... " << num_jumps - jumps.size() << " more, " << num_jumps << " jumps in total" << std::endl;
 		}
+		std::cout << std::endl;
 
-		{
-			std::cout << "TIMESTAMP ORDER" << std::endl;
-			uint64_t last_t = events.front().t;
-			for(std::size_t i=0; i<events.size(); i++) {
-				uint64_t t = events[i].t;
-				//if(t - last_t > 1000) std::cout << "t=" << t << ", dt=" << t - last_t << std::endl;
-				if(t < last_t) {
-					std::cout << "\tevent " << i << ": " << last_t << " -> " << t << std::endl;
-				}
-				last_t = t;
-			}
-			std::cout << std::endl;
+		std::cout << "TIMESTAMP ORDER" << std::endl;
+		for(const auto& u : order) {
+			std::cout << "\tevent " << u[0] << ": " << u[1] << " -> " << u[2] << std::endl;
+		}
+		if(num_order > order.size()) {
+			std::cout << "\t... " << num_order - order.size() << " more, " << num_order << " unordered timestamps in total" << std::endl;
 		}
+		std::cout << std::endl;
 
 		{
-			typedef acc::accumulator_set<uint64_t, acc::stats<
-					acc::tag::mean
-					,acc::tag::variance
-					,acc::tag::p_square_cumulative_distribution
-					>> accumulator_t;
-			accumulator_t a(acc::tag::p_square_cumulative_distribution::num_cells = 5);	
-
-			// fill in data
-			for(std::size_t i=1; i<events.size(); i++) {
-				uint64_t t1 = events[i-1].t;
-				uint64_t t2 = events[i].t;
-				if(t1 < t2) {
-					a(std::abs(t2 - t1));
-				}
-			}
-
 			std::cout << "STATISTICS" << std::endl;
 			std::cout << "\t" << "mean: " << acc::mean(a) << " µs" << std::endl;
 			std::cout << "\t" << "sqrt(variance): " << std::sqrt(acc::variance(a)) << " µs" << std::endl;
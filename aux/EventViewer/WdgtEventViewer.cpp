@@ -6,6 +6,7 @@
 #include <boost/format.hpp>
 #include <boost/progress.hpp>
 #include <algorithm>
+#include <fstream>
 
 constexpr int OMNIROB_CNT = 7;
 
@@ -52,26 +53,33 @@ void WdgtEventViewer::loadEventFile(const std::string& fn)
 	boost::timer timer;
 	if(is_omnirob_) {
 		boost::format fn_fmt(fn + "-%1%.txt");
-		events_.clear();
+		std::vector<std::string> fns;
 		for(unsigned int i=0; i<OMNIROB_CNT; i++) {
 			std::string fni = (fn_fmt % i).str();
-			std::cout << "Loading '" << fni << "'... " << std::flush;
-			std::vector<Edvs::Event> events = Edvs::LoadEventsJC(fni);
-			std::cout << events.size() << std::endl;
-			events_.insert(events_.end(), events.begin(), events.end());
-		}
-		std::cout << "Sorting events..." << std::endl;
-		std::sort(events_.begin(), events_.end(),
-			[](const Edvs::Event& x, const Edvs::Event& y) {
-				return x.t < y.t;
+			// a missing sensor file does not prevent loading the others
+			if(!std::ifstream(fni)) {
+				std::cerr << "Warning: Could not open '" << fni << "', skipping this sensor" << std::endl;
+				continue;
 			}
-		);
+			fns.push_back(fni);
+		}
+		// files of all sensors are loaded concurrently and merged by timestamp
+		std::cout << "Loading '" << fn << "-[0-" << OMNIROB_CNT-1 << "].txt'... " << std::endl;
+		events_.clear();
+		if(!Edvs::LoadEventsMerged(fns, "jc", events_)) {
+			std::cerr << "Error: Could not load the sensor files '" << fn << "-[0-" << OMNIROB_CNT-1 << "].txt'!" << std::endl;
+			events_.clear();
+		}
 	}
 	else {
 		std::cout << "Loading '" << fn << "'... " << std::endl;
 		events_ = Edvs::LoadEventsJC(fn);
 	}
 	std::cout << "Loaded " << events_.size() << " events in " << timer.elapsed() << " s" << std::endl;
+	if(events_.empty()) {
+		std::cerr << "Error: No events loaded!" << std::endl;
+		return;
+	}
 	ui.horizontalSliderTime->setMinimum(events_.front().t/1000);
 	ui.horizontalSliderTime->setMaximum(events_.back().t/1000);
 	ui.horizontalSliderEvent->setMinimum(0);
@@ -11,9 +11,10 @@ int main(int argc, char* argv[])
 	// open stream
 	std::shared_ptr<Edvs::IEventStream> stream = Edvs::OpenEventStream(argv[1]);
 	// capture events (run until EOF or Ctrl+C)
+	std::vector<Edvs::Event> events; // reused to avoid allocations
 	while(!stream->eos()) {	// FIXME make it possible to stop the loop by pressing a button
-		// read events from stream
-		auto events = stream->read();
+		// wait for events from stream (at most 100 ms)
+		stream->read_wait(events, 1, std::chrono::milliseconds(100));
 		// display message
 		if(!events.empty()) {
 			std::cout << "Time " << events.back().t << ": " << events.size() << " events" << std::endl;
@@ -83,9 +83,10 @@ int main(int argc, char* argv[])
 	auto stream = Edvs::OpenEventStream(p_uri);
 
 	std::cout << "Running event capture ..." << std::endl;
+	std::vector<Edvs::Event> events;
 	while(!stream->eos()) { // FIXME make it possible to stop the loop by pressing a button
-		// read events
-		auto events = stream->read();
+		// wait for events (at most 100 ms)
+		stream->read_wait(events, 1, std::chrono::milliseconds(100));
 		// process events
 		if(p_measure_speed) {
 			MeasureSpeed(events);
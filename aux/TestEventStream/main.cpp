@@ -0,0 +1,187 @@
+/*
+ * main.cpp
+ *
+ * Checks that multiple file streams are merged in timestamp order
+ * and that no events are lost at the end of the streams.
+ * Returns 0 if all checks pass.
+ */
+
+#include <Edvs/EventStream.hpp>
+#include <Edvs/EventIO.hpp>
+#include <Edvs/EventRingBuffer.hpp>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+
+std::vector<Edvs::Event> CreateEvents(const std::vector<uint64_t>& ts)
+{
+	std::vector<Edvs::Event> v(ts.size());
+	for(std::size_t i=0; i<ts.size(); i++) {
+		v[i].t = ts[i];
+		v[i].x = i;
+		v[i].y = i;
+		v[i].parity = 0;
+		v[i].id = 0;
+	}
+	return v;
+}
+
+bool Check(const std::string& name, const std::vector<Edvs::Event>& events, const std::vector<uint64_t>& expected)
+{
+	bool ok = (events.size() == expected.size());
+	for(std::size_t i=0; ok && i<events.size(); i++) {
+		ok = (events[i].t == expected[i]);
+	}
+	std::cout << (ok ? "OK     " : "FAILED ") << name << ":";
+	for(const Edvs::Event& e : events) {
+		std::cout << " " << e.t;
+	}
+	std::cout << std::endl;
+	return ok;
+}
+
+/** Stream A is blocked by the common time while stream B still has an event before it */
+bool TestReadUntilReleasesAllQueues()
+{
+	const std::string fn_a = "TestEventStream_a.events";
+	const std::string fn_b = "TestEventStream_b.events";
+	Edvs::SaveEvents(fn_a, CreateEvents({1, 2, 3, 10}));
+	Edvs::SaveEvents(fn_b, CreateEvents({5}));
+	bool ok = true;
+	{
+		// a large playback step delivers the whole files with the first read
+		std::vector<std::string> uris = { fn_a + "?dt=1000000", fn_b + "?dt=1000000" };
+		std::shared_ptr<Edvs::IEventStream> stream = Edvs::OpenEventStream(uris);
+		ok = Check("read_until(7)", stream->read_until(7, std::chrono::seconds(1)), {1, 2, 3, 5}) && ok;
+		ok = Check("read_until(11)", stream->read_until(11, std::chrono::seconds(1)), {10}) && ok;
+	}
+	std::remove(fn_a.c_str());
+	std::remove(fn_b.c_str());
+	return ok;
+}
+
+/** Reading until end of stream delivers all events of both files in order although one file ends first */
+bool TestEosWaitsForAllStreams()
+{
+	const std::string fn_a = "TestEventStream_a.events";
+	const std::string fn_b = "TestEventStream_b.events";
+	std::vector<uint64_t> ts_a, ts_b;
+	for(uint64_t i=0; i<100000; i++) {
+		ts_a.push_back(i);
+	}
+	for(uint64_t i=0; i<100010; i++) {
+		ts_b.push_back(2*i + 1);
+	}
+	Edvs::SaveEvents(fn_a, CreateEvents(ts_a));
+	Edvs::SaveEvents(fn_b, CreateEvents(ts_b));
+	bool ok = true;
+	{
+		// realtime playback, stream B still delivers events after stream A ended
+		std::vector<std::string> uris = { fn_a, fn_b };
+		std::shared_ptr<Edvs::IEventStream> stream = Edvs::OpenEventStream(uris);
+		std::vector<Edvs::Event> events;
+		while(!stream->eos()) {
+			const std::vector<Edvs::Event> v = stream->read_wait(1, std::chrono::milliseconds(100));
+			events.insert(events.end(), v.begin(), v.end());
+		}
+		bool is_sorted = true;
+		for(std::size_t i=1; i<events.size(); i++) {
+			is_sorted = is_sorted && (events[i-1].t <= events[i].t);
+		}
+		ok = (events.size() == ts_a.size() + ts_b.size()) && is_sorted;
+		std::cout << (ok ? "OK     " : "FAILED ") << "read until eos: " << events.size()
+			<< " of " << ts_a.size() + ts_b.size() << " events"
+			<< (is_sorted ? "" : ", not sorted") << std::endl;
+	}
+	std::remove(fn_a.c_str());
+	std::remove(fn_b.c_str());
+	return ok;
+}
+
+/** read_until returns all events before its time although the capture thread blocks on a small buffer */
+bool TestReadUntilWaitsForCapture()
+{
+	const std::string fn = "TestEventStream_c.events";
+	std::vector<uint64_t> ts;
+	for(uint64_t i=0; i<20000; i++) {
+		ts.push_back(i);
+	}
+	Edvs::SaveEvents(fn, CreateEvents(ts));
+	bool ok = true;
+	{
+		// the buffer is smaller than one read of the capture thread
+		Edvs::EventStreamParameters params;
+		params.buffer_capacity = 256;
+		params.overflow_policy = Edvs::OverflowPolicy::Block;
+		std::shared_ptr<Edvs::IEventStream> stream = Edvs::OpenEventStream(fn + "?dt=1000000", params);
+		uint64_t expected = 0;
+		for(uint64_t time=100; ok && time<=ts.size(); time+=100) {
+			const std::vector<Edvs::Event> v = stream->read_until(time, std::chrono::seconds(1));
+			for(const Edvs::Event& e : v) {
+				ok = ok && (e.t == expected);
+				expected++;
+			}
+			ok = ok && (expected == time);
+		}
+		std::cout << (ok ? "OK     " : "FAILED ") << "read_until with a full buffer: " << expected
+			<< " of " << ts.size() << " events" << std::endl;
+	}
+	std::remove(fn.c_str());
+	return ok;
+}
+
+/** The consumer never gets more events than the capacity while the producer discards old events */
+bool TestRingBufferDropOldest()
+{
+	const std::size_t capacity = 64;
+	const uint64_t num_events = 50000;
+	Edvs::EventRingBuffer buffer(capacity, Edvs::OverflowPolicy::DropOldest);
+	std::atomic<bool> is_done(false);
+	std::thread producer([&]() {
+		edvs_event_t block[16];
+		for(uint64_t t=0; t<num_events; t+=16) {
+			for(uint64_t i=0; i<16; i++) {
+				block[i].t = t + i;
+			}
+			buffer.push(block, 16);
+			// let the consumer run in between also on a single core
+			std::this_thread::yield();
+		}
+		is_done = true;
+	});
+	// more room than the ring buffer has
+	std::vector<edvs_event_t> out(16*capacity);
+	bool ok = true;
+	uint64_t last_t = 0;
+	bool is_first = true;
+	while(true) {
+		const bool was_done = is_done;
+		const std::size_t m = buffer.pop(out.data(), out.size());
+		ok = ok && (m <= capacity);
+		for(std::size_t i=0; ok && i<m; i++) {
+			ok = (is_first || out[i].t > last_t) && out[i].t < num_events;
+			last_t = out[i].t;
+			is_first = false;
+		}
+		if(!ok || (was_done && m == 0)) {
+			break;
+		}
+	}
+	producer.join();
+	std::cout << (ok ? "OK     " : "FAILED ") << "ring buffer pop while dropping oldest: "
+		<< buffer.num_dropped() << " dropped" << std::endl;
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	bool ok = true;
+	ok = TestReadUntilReleasesAllQueues() && ok;
+	ok = TestEosWaitsForAllStreams() && ok;
+	ok = TestReadUntilWaitsForCapture() && ok;
+	ok = TestRingBufferDropOldest() && ok;
+	return ok ? 0 : 1;
+}
@@ -6,207 +6,775 @@
  */
 
 #include "LoadSaveEvents.hpp"
-#include <boost/lexical_cast.hpp>
-#include <boost/algorithm/string.hpp>
-#include <boost/algorithm/string/split.hpp>
+#include "TextParsing.hpp"
+#include "TextFormatting.hpp"
+#include <Edvs/EventIO.hpp>
 #include <fstream>
 #include <algorithm>
+#include <functional>
 #include <iostream>
-#include <sstream>
 #include <string>
 #include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdio.h>
 
 namespace Edvs
 {
 
-struct TimeUnroller
+/** Unwraps device timestamps which wrap after a known period
+ * A backward jump by more than half the period is a wrap. Smaller backward
+ * jumps are jitter between sensors and do not advance the time. Timestamps
+ * which are not smaller than the period can not be unwrapped and are counted.
+ */
+class TimestampUnwrapper
 {
-	TimeUnroller()
-	: current_time_(0), last_time_(0)
+public:
+	TimestampUnwrapper(uint64_t wrap)
+	: wrap_(wrap), is_first_(true), last_time_(0), current_time_(0), num_out_of_range_(0)
 	{}
 
 	uint64_t operator()(uint64_t t) {
-		if(current_time_ == 0 && last_time_ == 0) {
+		if(t >= wrap_) {
+			num_out_of_range_++;
+		}
+		if(is_first_) {
+			is_first_ = false;
+			current_time_ = t;
 			last_time_ = t;
 		}
-		uint64_t dt;
-		if(last_time_ <= t) {
-			dt = t - last_time_;
+		else if(last_time_ <= t) {
+			current_time_ += t - last_time_;
+			last_time_ = t;
 		}
-		else {
-			dt = 2*t; // HACK we do not know when it wraps!
+		else if(last_time_ - t > wrap_/2 && last_time_ < wrap_) {
+			current_time_ += (wrap_ - last_time_) + t;
+			last_time_ = t;
 		}
-		last_time_ = t;
-		current_time_ += dt;
+		// on jitter 'last_time_' stays the latest raw timestamp, so it is not counted twice
 		return current_time_;
 	}
 
+	uint64_t wrap() const
+	{ return wrap_; }
+
+	std::size_t num_out_of_range() const
+	{ return num_out_of_range_; }
+
 private:
-	uint64_t current_time_;
+	uint64_t wrap_;
+	bool is_first_;
 	uint64_t last_time_;
+	uint64_t current_time_;
+	std::size_t num_out_of_range_;
 };
 
-inline uint32_t parse_coord_fast(unsigned char c, unsigned char b, unsigned char a) {
-	return                static_cast<uint32_t>(a - '0')
-	+ (b == ' ' ? 0 :  10*static_cast<uint32_t>(b - '0'))
-	+ (c == ' ' ? 0 : 100*static_cast<uint32_t>(c - '0'));
-}
+/** Number of events read at once from binary files */
+const std::size_t cBatchSize = 1<<16;
+
+/** Number of bytes parsed at once from text files */
+const std::size_t cTextBlockSize = 8<<20;
+
+/** Number of events formatted at once by one thread when writing text files */
+const std::size_t cFormatBlockSize = 1<<16;
 
-template<typename StrIt>
-inline uint64_t parse_timestamp_fast(StrIt it, const StrIt& end) {
-	uint64_t result = 0;
-	uint64_t mult = 1;
-	while(it != end && *it < '0' && '9' < *it) ++it;
-	while(it != end && *it != ' ') {
-		result += mult*static_cast<uint64_t>(*it - '0');
-		mult *= 10;
-		++it;
+/** Prints a warning if lines could not be parsed */
+void ReportMalformedLines(const std::string& filename, std::size_t num_malformed)
+{
+	if(num_malformed > 0) {
+		std::cerr << "Skipped " << num_malformed << " malformed lines in file '" << filename << "'" << std::endl;
 	}
-	return result;
 }
 
-bool jc_has_id(const std::string& line)
+/** Prints a warning if timestamps were too large to detect wraps */
+void ReportOutOfRangeTimestamps(const std::string& filename, const TimestampUnwrapper& unwrapper)
 {
-	return line.length() >= 21;
+	if(unwrapper.num_out_of_range() > 0) {
+		std::cerr << "Found " << unwrapper.num_out_of_range() << " timestamps not smaller than the wrap period "
+			<< unwrapper.wrap() << " in file '" << filename << "', wraps can not be detected!" << std::endl;
+	}
 }
 
-std::vector<Edvs::Event> LoadEventsJC(const std::string& filename, bool unwrap_timestamps)
+/** Parses one line of a table file: t, x, y, parity, id */
+struct TableLineParser
 {
-	std::vector<Event> events;
-	events.reserve(100000);
-	// 012345678901234567890
-	// 0 0  54  60  38928595
-	std::ifstream ifs(filename);
-	if(!ifs.is_open()) {
-		std::cerr << "Could not open file!" << std::endl;
-		return {};
-	}
-	std::string line;
-	Event e;
-	TimeUnroller unroller;
-	// bool first_line = true;
-	// uint64_t start_time;
-	while(getline(ifs, line)) {
-		bool has_id = jc_has_id(line);
-		if(has_id) {
-			e.id = static_cast<uint8_t>(line[0] - '0');
-			e.parity = (line[2] == '0' ? 0 : 1);
-			e.x = static_cast<uint16_t>(parse_coord_fast(line[4], line[5], line[6]));
-			e.y = static_cast<uint16_t>(parse_coord_fast(line[8], line[9], line[10]));
-			e.t = parse_timestamp_fast(line.rbegin(), line.rbegin() + 8);
+	char separator;
+
+	bool operator()(const char* p, const char* end, Event& e) const
+	{
+		unsigned parity, id;
+		if((p = ParseUnsignedField(p, end, e.t, separator)) == 0
+			|| (p = ParseUnsignedField(p, end, e.x, separator)) == 0
+			|| (p = ParseUnsignedField(p, end, e.y, separator)) == 0
+			|| (p = ParseUnsignedField(p, end, parity, separator)) == 0
+			|| ParseUnsigned(p, end, id) != end) {
+			return false;
+		}
+		e.parity = parity;
+		e.id = id;
+		return true;
+	}
+};
+
+/** Parses one line of an EB-SLAM-3D file: KX, KY, KD, X, Y, T, P */
+struct EBSLAM3LineParser
+{
+	bool operator()(const char* p, const char* end, Event& e) const
+	{
+		unsigned parity;
+		if((p = SkipField(p, end, '\t')) == 0
+			|| (p = SkipField(p, end, '\t')) == 0
+			|| (p = SkipField(p, end, '\t')) == 0
+			|| (p = ParseUnsignedField(p, end, e.x, '\t')) == 0
+			|| (p = ParseUnsignedField(p, end, e.y, '\t')) == 0
+			|| (p = ParseUnsignedField(p, end, e.t, '\t')) == 0
+			|| ParseUnsigned(p, end, parity) != end) {
+			return false;
+		}
+		e.parity = parity;
+		e.id = 0;
+		return true;
+	}
+};
+
+/** Parses one line of a JC file with fixed width fields
+ * With id:    "I P XXX YYY TTTTTTTTT"
+ * Without id: "XXX YYY P TTTTTTTTT"
+ * Coordinates and timestamps are right aligned. The timestamp field is the
+ * rest of the line, so longer timestamps than the usual 9 columns are parsed.
+ */
+struct JCLineParser
+{
+	bool operator()(const char* line, const char* end, Event& e) const
+	{
+		// 012345678901234567890
+		// 0 0  54  60  38928595
+		// 127  74 0    37111
+		const std::size_t length = end - line;
+		unsigned id, parity;
+		const char* t;
+		if(length >= 21) {
+			if(!ParseFixedWidth(line, line + 1, id)
+				|| !ParseFixedWidth(line + 2, line + 3, parity)
+				|| !ParseFixedWidth(line + 4, line + 7, e.x)
+				|| !ParseFixedWidth(line + 8, line + 11, e.y)) {
+				return false;
+			}
+			t = line + 11;
+		}
+		else if(length >= 10) {
+			id = 0;
+			if(!ParseFixedWidth(line, line + 3, e.x)
+				|| !ParseFixedWidth(line + 4, line + 7, e.y)
+				|| !ParseFixedWidth(line + 8, line + 9, parity)) {
+				return false;
+			}
+			t = line + 9;
 		}
 		else {
-			e.id = 0;
-			e.x = static_cast<uint16_t>(parse_coord_fast(line[0], line[1], line[2]));
-			e.y = static_cast<uint16_t>(parse_coord_fast(line[4], line[5], line[6]));
-			e.parity = (line[8] == '0' ? 0 : 1);
-			e.t = parse_timestamp_fast(line.rbegin(), line.rbegin() + 8);
-		}
-		if(unwrap_timestamps) {
-			e.t = unroller(e.t);
-		}
-		// if(flags & EventFileFlag::BeginTimeZero) {
-		// 	if(first_line)
-		// 	{
-		// 		first_line = false;
-		// 		start_time = e.t;
-		// 	}
-		// 	e.t -= start_time;
-		// }
-		events.push_back(e);
+			return false;
+		}
+		if(parity > 1 || line[3] != ' ' || line[7] != ' ' || !ParseFixedWidth(t, end, e.t)) {
+			return false;
+		}
+		e.id = id;
+		e.parity = parity;
+		return true;
 	}
-	return events;
+};
+
+/** Reads a line based text file in blocks of lines, see ParseLinesParallel */
+template<typename ParseLine>
+class TextEventReader : public EventReader
+{
+public:
+	TextEventReader(const std::string& filename, const ParseLine& parse_line)
+	: filename_(filename), file_(filename), parse_line_(parse_line), num_malformed_(0)
+	{
+		pos_ = file_.begin();
+	}
+
+	~TextEventReader()
+	{
+		ReportMalformedLines(filename_, num_malformed_);
+	}
+
+	bool is_open() const
+	{ return file_.is_open(); }
+
+	std::size_t next_batch(std::vector<Event>& events)
+	{
+		events.clear();
+		while(events.empty() && pos_ != file_.end()) {
+			const char* end = file_.end();
+			if(static_cast<std::size_t>(end - pos_) > cTextBlockSize) {
+				end = NextLine(pos_ + cTextBlockSize - 1, end);
+			}
+			num_malformed_ += ParseLinesParallel(pos_, end, parse_line_, events);
+			pos_ = end;
+			file_.discard(pos_);
+		}
+		return events.size();
+	}
+
+private:
+	std::string filename_;
+	MappedFile file_;
+	ParseLine parse_line_;
+	const char* pos_;
+	std::size_t num_malformed_;
+};
+
+/** Reads a JC file in parallel blocks and optionally unwraps timestamps */
+class JCEventReader : public EventReader
+{
+public:
+	JCEventReader(const std::string& filename, bool unwrap_timestamps, uint64_t timestamp_wrap)
+	: filename_(filename), reader_(filename, JCLineParser()), unwrap_timestamps_(unwrap_timestamps), unwrapper_(timestamp_wrap)
+	{}
+
+	~JCEventReader()
+	{
+		ReportOutOfRangeTimestamps(filename_, unwrapper_);
+	}
+
+	bool is_open() const
+	{ return reader_.is_open(); }
+
+	std::size_t next_batch(std::vector<Event>& events)
+	{
+		reader_.next_batch(events);
+		// lines are parsed in parallel, but timestamps must be unwrapped in order
+		if(unwrap_timestamps_) {
+			for(Event& e : events) {
+				e.t = unwrapper_(e.t);
+			}
+		}
+		return events.size();
+	}
+
+private:
+	std::string filename_;
+	TextEventReader<JCLineParser> reader_;
+	bool unwrap_timestamps_;
+	TimestampUnwrapper unwrapper_;
+};
+
+/** Reads the old binary format with 21 bytes per event */
+class OldEventReader : public EventReader
+{
+public:
+	OldEventReader(const std::string& filename, bool unwrap_timestamps, uint64_t timestamp_wrap)
+	: filename_(filename), ifs_(filename, std::ios::binary), unwrap_timestamps_(unwrap_timestamps), unwrapper_(timestamp_wrap), buffer_(21*cBatchSize)
+	{
+		if(!ifs_.is_open()) {
+			std::cerr << "Could not open file '" << filename << "'!" << std::endl;
+		}
+	}
+
+	~OldEventReader()
+	{
+		ReportOutOfRangeTimestamps(filename_, unwrapper_);
+	}
+
+	bool is_open() const
+	{ return ifs_.is_open(); }
+
+	std::size_t next_batch(std::vector<Event>& events)
+	{
+		ifs_.read(buffer_.data(), buffer_.size());
+		// incomplete events at the end of the file are ignored
+		const std::size_t n = ifs_.gcount() / 21;
+		events.resize(n);
+		for(std::size_t i=0; i<n; i++) {
+			const char* buff = buffer_.data() + 21*i;
+			uint32_t id;
+			float x, y;
+			Event& e = events[i];
+			std::memcpy(&id, buff, 4);
+			std::memcpy(&x, buff + 5, 4);
+			std::memcpy(&y, buff + 9, 4);
+			std::memcpy(&e.t, buff + 13, 8);
+			e.id = id;
+			e.parity = (buff[4] == 0 ? false : true);
+			e.x = x;
+			e.y = y;
+			if(unwrap_timestamps_) {
+				e.t = unwrapper_(e.t);
+			}
+		}
+		return n;
+	}
+
+private:
+	std::string filename_;
+	std::ifstream ifs_;
+	bool unwrap_timestamps_;
+	TimestampUnwrapper unwrapper_;
+	std::vector<char> buffer_;
+};
+
+/** Reads binary event files with or without header (any encoding and compression) */
+class NaturalEventReader : public EventReader
+{
+public:
+	NaturalEventReader(const std::string& filename)
+	: fh_(fopen(filename.c_str(), "rb")), reader_(0)
+	{
+		if(fh_ == 0) {
+			std::cerr << "Could not open file '" << filename << "'!" << std::endl;
+			return;
+		}
+		reader_ = edvs_file_reader_open(fh_);
+	}
+
+	~NaturalEventReader()
+	{
+		if(reader_) {
+			edvs_file_reader_close(reader_);
+		}
+		if(fh_) {
+			fclose(fh_);
+		}
+	}
+
+	bool is_open() const
+	{ return reader_ != 0; }
+
+	std::size_t next_batch(std::vector<Event>& events)
+	{
+		events.resize(cBatchSize);
+		const ssize_t m = edvs_file_reader_read(reader_, events.data(), events.size());
+		events.resize(std::max<ssize_t>(m, 0));
+		return events.size();
+	}
+
+private:
+	FILE* fh_;
+	edvs_file_reader_t* reader_;
+};
+
+/** Writes binary event files with header and index
+ * The sensor ids in the header are set to the ids which occur in the file.
+ */
+class NaturalEventWriter : public EventWriter
+{
+public:
+	NaturalEventWriter(const std::string& filename, const EventFileHeader& header)
+	: fh_(fopen(filename.c_str(), "w")), writer_(0), has_id_(EDVS_FILE_MAX_SENSORS, false)
+	{
+		if(fh_ == 0) {
+			std::cerr << "Error opening file '" << filename << "'!" << std::endl;
+			return;
+		}
+		writer_ = edvs_file_writer_open(fh_, &header);
+	}
+
+	~NaturalEventWriter()
+	{
+		close();
+	}
+
+	bool is_open() const
+	{ return writer_ != 0; }
+
+	bool write_batch(const Event* events, std::size_t n)
+	{
+		for(std::size_t i=0; i<n; i++) {
+			has_id_[events[i].id] = true;
+		}
+		return edvs_file_writer_write(writer_, events, n) >= 0;
+	}
+
+	bool close()
+	{
+		bool ok = true;
+		if(writer_) {
+			writer_->header.num_sensors = 0;
+			for(unsigned id=0; id<EDVS_FILE_MAX_SENSORS; id++) {
+				if(has_id_[id]) {
+					writer_->header.sensor_ids[writer_->header.num_sensors++] = id;
+				}
+			}
+			ok = (edvs_file_writer_close(writer_) == 0);
+			writer_ = 0;
+		}
+		if(fh_) {
+			ok = (fclose(fh_) == 0) && ok;
+			fh_ = 0;
+		}
+		return ok;
+	}
+
+private:
+	FILE* fh_;
+	edvs_file_writer_t* writer_;
+	std::vector<bool> has_id_;
+};
+
+/** Writes events in table format: t, x, y, parity, id
+ * Lines are formatted into large blocks, one block per thread in parallel,
+ * and the blocks are written in order.
+ */
+class TableEventWriter : public EventWriter
+{
+public:
+	TableEventWriter(const std::string& filename, char separator)
+	: fh_(fopen(filename.c_str(), "w")), separator_(separator)
+	{
+		if(fh_ == 0) {
+			std::cerr << "Error opening file '" << filename << "'!" << std::endl;
+		}
+		const unsigned num_threads = std::thread::hardware_concurrency();
+		blocks_.resize(std::min<unsigned>(std::max<unsigned>(num_threads, 1), 8));
+	}
+
+	~TableEventWriter()
+	{
+		close();
+	}
+
+	bool is_open() const
+	{ return fh_ != 0; }
+
+	bool write_batch(const Event* events, std::size_t n)
+	{
+		while(n > 0) {
+			const std::size_t num_blocks = std::min(blocks_.size(), (n + cFormatBlockSize - 1) / cFormatBlockSize);
+			auto format_block = [this, events, n](std::size_t k) {
+				const std::size_t begin = k*cFormatBlockSize;
+				const std::size_t end = std::min(n, begin + cFormatBlockSize);
+				std::vector<char>& block = blocks_[k];
+				block.resize((end - begin)*cMaxTableLineSize);
+				char* p = block.data();
+				for(std::size_t i=begin; i<end; i++) {
+					p = FormatTableLine(p, events[i], separator_);
+				}
+				block.resize(p - block.data());
+			};
+			std::vector<std::thread> threads;
+			for(std::size_t k=1; k<num_blocks; k++) {
+				threads.emplace_back(format_block, k);
+			}
+			format_block(0);
+			for(std::thread& t : threads) {
+				t.join();
+			}
+			for(std::size_t k=0; k<num_blocks; k++) {
+				if(fwrite(blocks_[k].data(), 1, blocks_[k].size(), fh_) != blocks_[k].size()) {
+					return false;
+				}
+			}
+			const std::size_t m = std::min(n, num_blocks*cFormatBlockSize);
+			events += m;
+			n -= m;
+		}
+		return true;
+	}
+
+	bool close()
+	{
+		if(fh_ == 0) {
+			return true;
+		}
+		const bool ok = (fclose(fh_) == 0);
+		fh_ = 0;
+		return ok;
+	}
+
+private:
+	FILE* fh_;
+	char separator_;
+	std::vector<std::vector<char>> blocks_;
+};
+
+/** Returns 'p' if it was opened successfully and null otherwise */
+template<typename T, typename Base>
+std::unique_ptr<Base> OpenedOrNull(T* p)
+{
+	std::unique_ptr<T> q(p);
+	if(!q->is_open()) {
+		return std::unique_ptr<Base>();
+	}
+	return std::unique_ptr<Base>(q.release());
 }
 
-std::vector<Edvs::Event> LoadEventsOld(const std::string& filename, bool unwrap_timestamps)
+std::unique_ptr<EventReader> OpenEventReader(const std::string& filename, const std::string& format, uint64_t timestamp_wrap)
 {
-	std::vector<Event> events;
-	events.reserve(100000);
-	std::ifstream ifs(filename, std::ios::binary);
-	char buff[21];
-	TimeUnroller unroller;
-	while(!ifs.eof()) {
-		ifs.read((char*)buff, 21);
-		Event e;
-		e.id = *reinterpret_cast<uint32_t*>(buff);
-		e.parity = (*reinterpret_cast<uint8_t*>(buff + 4) == 0 ? false : true);
-		e.x = *reinterpret_cast<float*>(buff + 5);
-		e.y = *reinterpret_cast<float*>(buff + 9);
-		e.t = *reinterpret_cast<uint64_t*>(buff + 13);
-		if(unwrap_timestamps) {
-			e.t = unroller(e.t);
-		}
-		events.push_back(e);
+	if(format == "natural" || format == "compact") {
+		return OpenedOrNull<NaturalEventReader,EventReader>(new NaturalEventReader(filename));
 	}
-	return events;
+	if(format == "csv" || format == "tsv") {
+		TableLineParser parser;
+		parser.separator = (format == "csv") ? ',' : '\t';
+		return OpenedOrNull<TextEventReader<TableLineParser>,EventReader>(new TextEventReader<TableLineParser>(filename, parser));
+	}
+	if(format == "ebslam3") {
+		return OpenedOrNull<TextEventReader<EBSLAM3LineParser>,EventReader>(new TextEventReader<EBSLAM3LineParser>(filename, EBSLAM3LineParser()));
+	}
+	if(format == "jc") {
+		return OpenedOrNull<JCEventReader,EventReader>(new JCEventReader(filename, true, timestamp_wrap));
+	}
+	if(format == "old") {
+		return OpenedOrNull<OldEventReader,EventReader>(new OldEventReader(filename, true, timestamp_wrap));
+	}
+	std::cerr << "Unsupported input file format '" << format << "'!" << std::endl;
+	return std::unique_ptr<EventReader>();
 }
 
-std::vector<Event> LoadEventsTable(const std::string& filename, char separator)
+std::unique_ptr<EventWriter> OpenEventWriter(const std::string& filename, const std::string& format, uint32_t compression)
+{
+	if(format == "natural" || format == "compact") {
+		EventFileHeader header = CreateEventFileHeader(0, 0);
+		if(format == "compact") {
+			header.encoding = EDVS_ENCODING_DELTA;
+		}
+		header.compression = compression;
+		return OpenedOrNull<NaturalEventWriter,EventWriter>(new NaturalEventWriter(filename, header));
+	}
+	if(format == "csv" || format == "tsv") {
+		return OpenedOrNull<TableEventWriter,EventWriter>(new TableEventWriter(filename, (format == "csv") ? ',' : '\t'));
+	}
+	std::cerr << "Unsupported output file format '" << format << "'!" << std::endl;
+	return std::unique_ptr<EventWriter>();
+}
+
+bool CopyEvents(EventReader& reader, EventWriter& writer, uint64_t& num_events, std::size_t num_batches)
+{
+	// batches cycle between the reader thread (free -> full) and the writer (full -> free)
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::deque<std::vector<Event>> free(std::max<std::size_t>(num_batches, 1));
+	std::deque<std::vector<Event>> full;
+	bool is_done = false;
+	bool is_cancelled = false;
+	std::thread thread([&]() {
+		std::unique_lock<std::mutex> lock(mtx);
+		while(true) {
+			cv.wait(lock, [&]() { return !free.empty() || is_cancelled; });
+			if(is_cancelled) {
+				break;
+			}
+			std::vector<Event> batch;
+			batch.swap(free.front());
+			free.pop_front();
+			lock.unlock();
+			const std::size_t n = reader.next_batch(batch);
+			lock.lock();
+			if(n == 0) {
+				is_done = true;
+				cv.notify_all();
+				break;
+			}
+			full.push_back(std::vector<Event>());
+			full.back().swap(batch);
+			cv.notify_all();
+		}
+	});
+	bool ok = true;
+	num_events = 0;
+	std::unique_lock<std::mutex> lock(mtx);
+	while(true) {
+		cv.wait(lock, [&]() { return !full.empty() || is_done; });
+		if(full.empty()) {
+			break;
+		}
+		std::vector<Event> batch;
+		batch.swap(full.front());
+		full.pop_front();
+		lock.unlock();
+		ok = writer.write_batch(batch.data(), batch.size());
+		num_events += batch.size();
+		lock.lock();
+		free.push_back(std::vector<Event>());
+		free.back().swap(batch);
+		cv.notify_all();
+		if(!ok) {
+			is_cancelled = true;
+			cv.notify_all();
+			break;
+		}
+	}
+	lock.unlock();
+	thread.join();
+	return writer.close() && ok;
+}
+
+/** Reads all batches into one vector */
+std::vector<Event> ReadAllEvents(EventReader& reader)
 {
-	std::string separators;
-	separators.push_back(separator);
 	std::vector<Event> events;
-	events.reserve(100000);
-	std::ifstream is(filename);
-	std::string line;
-	std::vector<std::string> tokens;
-	Event e;
-	while(getline(is, line)) {
-		// eat \r at the end of line
-		if(line[line.size() - 1] == '\r') {
-			line.erase(line.size() - 1, 1);
-		}
-		// parse line
-		boost::split(tokens, line, boost::is_any_of(separators));
-		e.t = boost::lexical_cast<uint64_t>(tokens[0]);
-		e.x = boost::lexical_cast<uint16_t>(tokens[1]);
-		e.y = boost::lexical_cast<uint16_t>(tokens[2]);
-		e.parity = boost::lexical_cast<unsigned>(tokens[3]);
-		e.id = boost::lexical_cast<unsigned>(tokens[4]);
-		// std::istringstream iss(line);
-		// iss >> e.t >> e.x >> e.y >> e.parity >> e.id;
-		events.push_back(e);
+	std::vector<Event> batch;
+	while(reader.next_batch(batch) > 0) {
+		events.insert(events.end(), batch.begin(), batch.end());
 	}
 	return events;
 }
 
-std::vector<Edvs::Event> LoadEventsEBSLAM3(const std::string& filename)
+/** Minimum number of events merged by one thread */
+const std::size_t cMinEventsPerMergeThread = 1<<18;
+
+/** Number of timestamps sampled per part and thread to split the merge */
+const std::size_t cMergeSamples = 64;
+
+/** Merges the parts [begin[k], end[k][ of all parts into 'out'
+ * This is a k-way merge using a heap of part heads. Events with equal
+ * timestamps are taken from the part with the smaller index first.
+ */
+void MergeRanges(const std::vector<std::vector<Event>>& parts, const std::vector<std::size_t>& begin, const std::vector<std::size_t>& end, Event* out)
 {
-	std::vector<Event> events;
-	events.reserve(100000);
-	std::ifstream is(filename);
-	std::string line;
-	std::vector<std::string> tokens;
-	Event e;
-	while(getline(is, line)) {
-		// eat \r at the end of line
-		if(line[line.size() - 1] == '\r') {
-			line.erase(line.size() - 1, 1);
-		}
-		// parse line
-		boost::split(tokens, line, boost::is_any_of("\t"));
-		e.t = boost::lexical_cast<uint64_t>(tokens[5]);
-		e.x = boost::lexical_cast<uint16_t>(tokens[3]);
-		e.y = boost::lexical_cast<uint16_t>(tokens[4]);
-		e.parity = boost::lexical_cast<unsigned>(tokens[6]);
-		e.id = 0;
-		// std::istringstream iss(line);
-		// iss >> e.t >> e.x >> e.y >> e.parity >> e.id;
-		events.push_back(e);
+	typedef std::pair<uint64_t,std::size_t> HeapItem;
+	std::vector<HeapItem> heap;
+	std::vector<std::size_t> pos = begin;
+	for(std::size_t k=0; k<parts.size(); k++) {
+		if(pos[k] < end[k]) {
+			heap.push_back(std::make_pair(parts[k][pos[k]].t, k));
+		}
+	}
+	std::make_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+	while(!heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+		const std::size_t k = heap.back().second;
+		heap.pop_back();
+		// take all events of this part which are not later than the next part
+		const std::vector<Event>& part = parts[k];
+		if(heap.empty()) {
+			out = std::copy(part.begin() + pos[k], part.begin() + end[k], out);
+			pos[k] = end[k];
+			break;
+		}
+		const HeapItem next = heap.front();
+		std::size_t i = pos[k];
+		while(i < end[k] && (part[i].t < next.first || (part[i].t == next.first && k < next.second))) {
+			i++;
+		}
+		out = std::copy(part.begin() + pos[k], part.begin() + i, out);
+		pos[k] = i;
+		if(i < end[k]) {
+			heap.push_back(std::make_pair(part[i].t, k));
+			std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+		}
+	}
+}
+
+std::vector<Event> MergeEvents(std::vector<std::vector<Event>>& parts)
+{
+	const auto by_time = [](const Event& a, const Event& b) { return a.t < b.t; };
+	std::size_t total = 0;
+	for(std::size_t k=0; k<parts.size(); k++) {
+		if(!std::is_sorted(parts[k].begin(), parts[k].end(), by_time)) {
+			std::cerr << "Events of part " << k << " are not ordered by timestamp and are sorted before merging" << std::endl;
+			std::stable_sort(parts[k].begin(), parts[k].end(), by_time);
+		}
+		total += parts[k].size();
+	}
+	std::size_t num_threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+	num_threads = std::max<std::size_t>(1, std::min(num_threads, total / cMinEventsPerMergeThread));
+	// split timestamps from a sample of all parts
+	std::vector<uint64_t> samples;
+	for(const std::vector<Event>& part : parts) {
+		const std::size_t n = std::min(part.size(), cMergeSamples*num_threads);
+		for(std::size_t i=0; i<n; i++) {
+			samples.push_back(part[i*part.size()/n].t);
+		}
+	}
+	std::sort(samples.begin(), samples.end());
+	// thread j merges the events of all parts in [cuts[j][k], cuts[j+1][k][
+	std::vector<std::vector<std::size_t>> cuts(num_threads + 1, std::vector<std::size_t>(parts.size(), 0));
+	std::vector<std::size_t> offsets(num_threads + 1, 0);
+	for(std::size_t j=1; j<=num_threads; j++) {
+		for(std::size_t k=0; k<parts.size(); k++) {
+			if(j == num_threads) {
+				cuts[j][k] = parts[k].size();
+			}
+			else {
+				Event split;
+				split.t = samples[j*samples.size()/num_threads];
+				cuts[j][k] = std::lower_bound(parts[k].begin(), parts[k].end(), split, by_time) - parts[k].begin();
+			}
+			offsets[j] += cuts[j][k];
+		}
+	}
+	std::vector<Event> events(total);
+	std::vector<std::thread> threads;
+	for(std::size_t j=1; j<num_threads; j++) {
+		threads.emplace_back([&, j]() {
+			MergeRanges(parts, cuts[j], cuts[j+1], events.data() + offsets[j]);
+		});
+	}
+	MergeRanges(parts, cuts[0], cuts[1], events.data());
+	for(std::thread& t : threads) {
+		t.join();
 	}
 	return events;
 }
 
+bool LoadEventsMerged(const std::vector<std::string>& filenames, const std::string& format, std::vector<Event>& events, uint64_t timestamp_wrap)
+{
+	std::vector<std::unique_ptr<EventReader>> readers;
+	for(const std::string& fn : filenames) {
+		readers.push_back(OpenEventReader(fn, format, timestamp_wrap));
+		if(!readers.back()) {
+			return false;
+		}
+	}
+	// files are read concurrently, each reader may use multiple threads as well
+	std::vector<std::vector<Event>> parts(filenames.size());
+	std::vector<std::thread> threads;
+	for(std::size_t k=1; k<readers.size(); k++) {
+		threads.emplace_back([&, k]() {
+			parts[k] = ReadAllEvents(*readers[k]);
+		});
+	}
+	if(!readers.empty()) {
+		parts[0] = ReadAllEvents(*readers[0]);
+	}
+	for(std::thread& t : threads) {
+		t.join();
+	}
+	readers.clear();
+	events = MergeEvents(parts);
+	return true;
+}
+
+std::vector<Edvs::Event> LoadEventsJC(const std::string& filename, bool unwrap_timestamps, uint64_t timestamp_wrap)
+{
+	JCEventReader reader(filename, unwrap_timestamps, timestamp_wrap);
+	return ReadAllEvents(reader);
+}
+
+std::vector<Edvs::Event> LoadEventsOld(const std::string& filename, bool unwrap_timestamps, uint64_t timestamp_wrap)
+{
+	OldEventReader reader(filename, unwrap_timestamps, timestamp_wrap);
+	return ReadAllEvents(reader);
+}
+
+std::vector<Event> LoadEventsTable(const std::string& filename, char separator)
+{
+	TableLineParser parser;
+	parser.separator = separator;
+	TextEventReader<TableLineParser> reader(filename, parser);
+	return ReadAllEvents(reader);
+}
+
+std::vector<Edvs::Event> LoadEventsEBSLAM3(const std::string& filename)
+{
+	TextEventReader<EBSLAM3LineParser> reader(filename, EBSLAM3LineParser());
+	return ReadAllEvents(reader);
+}
 
 void SaveEventsTable(const std::string& filename, const std::vector<Edvs::Event>& events, char sep)
 {
-	std::ofstream ofs(filename);
-	for(const Event& e : events) {
-		ofs << e.t << sep
-			<< e.x << sep
-			<< e.y << sep
-			<< (unsigned int)e.parity << sep
-			<< (unsigned int)e.id << std::endl;
+	SaveEventsTable(filename, events.data(), events.size(), sep);
+}
+
+void SaveEventsTable(const std::string& filename, const Edvs::Event* events, std::size_t n, char sep)
+{
+	TableEventWriter writer(filename, sep);
+	if(writer.is_open()) {
+		writer.write_batch(events, n);
 	}
 }
 
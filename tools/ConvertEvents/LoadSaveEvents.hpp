@@ -11,25 +11,99 @@
 #include "Event.hpp"
 #include <string>
 #include <vector>
+#include <memory>
+#include <stdint.h>
 
 namespace Edvs
 {
+	/** Reads the events of a file in batches */
+	class EventReader
+	{
+	public:
+		virtual ~EventReader() {}
+
+		/** Reads the next batch of events
+		 * The previous content of 'events' is replaced. Its memory is reused so
+		 * that repeated calls with the same vector do not allocate.
+		 * @return number of events read, 0 at the end of the file
+		 */
+		virtual std::size_t next_batch(std::vector<Event>& events) = 0;
+	};
+
+	/** Writes events to a file in batches */
+	class EventWriter
+	{
+	public:
+		virtual ~EventWriter() {}
+
+		/** @return false if the events could not be written */
+		virtual bool write_batch(const Event* events, std::size_t n) = 0;
+
+		/** Finishes the file, called by the destructor if necessary
+		 * @return false if the file could not be written
+		 */
+		virtual bool close() = 0;
+	};
+
+	/** Default wrap period of raw device timestamps in jc and old files
+	 * JC files contain 32 bit eDVS timestamps (timestamps above 24 bit occur).
+	 */
+	const uint64_t cDeviceTimestampWrap = 1ull<<32;
+
+	/** Opens a file for reading in batches
+	 * Supported formats: natural, compact, csv, tsv, jc, ebslam3 and old.
+	 * Timestamps of jc and old files are unwrapped, device timestamps wrap to 0 after 'timestamp_wrap'.
+	 * @return null if the format is not supported or the file could not be opened
+	 */
+	std::unique_ptr<EventReader> OpenEventReader(const std::string& filename, const std::string& format, uint64_t timestamp_wrap=cDeviceTimestampWrap);
+
+	/** Opens a file for writing in batches
+	 * Supported formats: natural, compact (with 'compression'), csv and tsv.
+	 * @return null if the format is not supported or the file could not be opened
+	 */
+	std::unique_ptr<EventWriter> OpenEventWriter(const std::string& filename, const std::string& format, uint32_t compression=0);
+
+	/** Copies all events from 'reader' to 'writer' with constant memory
+	 * Batches are read on a separate thread while the calling thread writes,
+	 * with at most 'num_batches' batches in memory.
+	 * @param num_events set to the number of events written
+	 * @return false if the events could not be written
+	 */
+	bool CopyEvents(EventReader& reader, EventWriter& writer, uint64_t& num_events, std::size_t num_batches=4);
+
+	/** Merges parts which are each ordered by timestamp into one ordered list
+	 * Parts which are not ordered are sorted first. The merge runs on multiple
+	 * threads and events with equal timestamps keep the order of the parts.
+	 */
+	std::vector<Edvs::Event> MergeEvents(std::vector<std::vector<Edvs::Event>>& parts);
+
+	/** Loads several files concurrently and merges their events by timestamp
+	 * For example the files of multiple sensors which were recorded together.
+	 * Timestamps of jc and old files are unwrapped, see OpenEventReader.
+	 * @return false if a file could not be opened
+	 */
+	bool LoadEventsMerged(const std::vector<std::string>& filenames, const std::string& format, std::vector<Edvs::Event>& events, uint64_t timestamp_wrap=cDeviceTimestampWrap);
+
 	/** Loads events in table file format
 	 * Each line is one event and lines are separated with std::endl.
 	 * Each value in each line is separated by 'separator'
 	 * Values per line: t, x, y, parity, id
+	 * The file is mapped and parsed on multiple threads. Malformed lines are skipped.
 	 */
 	std::vector<Edvs::Event> LoadEventsTable(const std::string& filename, char separator);
 
 	/** Loads events from JC file format
-	 * Each line is one event.
-	 * Line format: XXX YYY P TTTTTTTTTT
+	 * Each line is one event with fixed width fields.
+	 * Line format: XXX YYY P TTTTTTTTT or with sensor id: I P XXX YYY TTTTTTTTT
+	 * The file is mapped and parsed on multiple threads. Malformed lines are skipped.
+	 * @param timestamp_wrap device timestamps wrap to 0 after this period
 	 */
-	std::vector<Edvs::Event> LoadEventsJC(const std::string& filename, bool unwrap_timestamps=false);
+	std::vector<Edvs::Event> LoadEventsJC(const std::string& filename, bool unwrap_timestamps=false, uint64_t timestamp_wrap=cDeviceTimestampWrap);
 
 	/** Loads events from EB-SLAM-3D file format
 	 * Each line is one event.
 	 * Line format: KX, KY, KD, X, Y, T, P
+	 * The file is mapped and parsed on multiple threads. Malformed lines are skipped.
 	 */
 	std::vector<Edvs::Event> LoadEventsEBSLAM3(const std::string& filename);
 
@@ -41,12 +115,14 @@ namespace Edvs
 	 * 		9-12: y as float
 	 * 		13-20: time as uint64_t
 	 */
-	std::vector<Edvs::Event> LoadEventsOld(const std::string& filename, bool unwrap_timestamps=false);
+	std::vector<Edvs::Event> LoadEventsOld(const std::string& filename, bool unwrap_timestamps=false, uint64_t timestamp_wrap=cDeviceTimestampWrap);
 
 	/** Saves a list of events in a file
 	 */
 	void SaveEventsTable(const std::string& filename, const std::vector<Edvs::Event>& events, char separator);
 
+	void SaveEventsTable(const std::string& filename, const Edvs::Event* events, std::size_t n, char separator);
+
 }
 
 #endif
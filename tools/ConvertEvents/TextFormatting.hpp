@@ -0,0 +1,73 @@
+/*
+ * TextFormatting.hpp
+ *
+ * Helpers for writing text event files quickly: integers are rendered
+ * directly into large character buffers instead of going through streams.
+ */
+
+#ifndef EDVS_TOOLS_TEXTFORMATTING_HPP_
+#define EDVS_TOOLS_TEXTFORMATTING_HPP_
+
+#include "Event.hpp"
+#include <cstring>
+#include <stdint.h>
+
+namespace Edvs
+{
+	/** Writes the decimal representation of 'v' to 'p'
+	 * @return pointer behind the last digit
+	 */
+	inline char* FormatUnsigned(char* p, uint64_t v)
+	{
+		// two digits at a time
+		static const char digits[] =
+			"0001020304050607080910111213141516171819"
+			"2021222324252627282930313233343536373839"
+			"4041424344454647484950515253545556575859"
+			"6061626364656667686970717273747576777879"
+			"8081828384858687888990919293949596979899";
+		char buffer[20];
+		char* q = buffer + sizeof(buffer);
+		while(v >= 100) {
+			const unsigned i = static_cast<unsigned>(v % 100) * 2;
+			v /= 100;
+			*--q = digits[i + 1];
+			*--q = digits[i];
+		}
+		if(v >= 10) {
+			const unsigned i = static_cast<unsigned>(v) * 2;
+			*--q = digits[i + 1];
+			*--q = digits[i];
+		}
+		else {
+			*--q = static_cast<char>('0' + v);
+		}
+		const std::size_t n = buffer + sizeof(buffer) - q;
+		std::memcpy(p, q, n);
+		return p + n;
+	}
+
+	/** Maximum number of characters of one line written by FormatTableLine */
+	const std::size_t cMaxTableLineSize = 20 + 5 + 5 + 3 + 3 + 5;
+
+	/** Writes one event in table format: t, x, y, parity, id and a line break
+	 * @return pointer behind the line break
+	 */
+	inline char* FormatTableLine(char* p, const Event& e, char separator)
+	{
+		p = FormatUnsigned(p, e.t);
+		*p++ = separator;
+		p = FormatUnsigned(p, e.x);
+		*p++ = separator;
+		p = FormatUnsigned(p, e.y);
+		*p++ = separator;
+		p = FormatUnsigned(p, e.parity);
+		*p++ = separator;
+		p = FormatUnsigned(p, e.id);
+		*p++ = '\n';
+		return p;
+	}
+
+}
+
+#endif
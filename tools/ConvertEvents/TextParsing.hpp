@@ -0,0 +1,285 @@
+/*
+ * TextParsing.hpp
+ *
+ * Helpers for parsing text event files quickly: memory mapped input,
+ * integer parsing without streams or temporary strings and parsing of
+ * line based files on multiple threads.
+ */
+
+#ifndef EDVS_TOOLS_TEXTPARSING_HPP_
+#define EDVS_TOOLS_TEXTPARSING_HPP_
+
+#include "Event.hpp"
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <limits>
+#include <iostream>
+#include <cstring>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace Edvs
+{
+	/** Read-only memory map of a whole file */
+	class MappedFile
+	{
+	public:
+		MappedFile()
+		: is_open_(false), data_(0), size_(0), num_discarded_(0)
+		{}
+
+		explicit MappedFile(const std::string& fn)
+		: MappedFile()
+		{ open(fn); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile()
+		{ close(); }
+
+		/** Maps the file and hints the operating system that it is read sequentially */
+		bool open(const std::string& fn)
+		{
+			close();
+			int fd = ::open(fn.c_str(), O_RDONLY);
+			if(fd < 0) {
+				std::cerr << "Could not open file '" << fn << "'!" << std::endl;
+				return false;
+			}
+			struct stat st;
+			if(fstat(fd, &st) != 0) {
+				std::cerr << "Could not read size of file '" << fn << "'!" << std::endl;
+				::close(fd);
+				return false;
+			}
+			size_ = st.st_size;
+			if(size_ > 0) {
+				void* p = mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+				if(p == MAP_FAILED) {
+					std::cerr << "Could not map file '" << fn << "'!" << std::endl;
+					::close(fd);
+					size_ = 0;
+					return false;
+				}
+				madvise(p, size_, MADV_SEQUENTIAL);
+				data_ = static_cast<const char*>(p);
+			}
+			// the mapping stays valid after closing the file
+			::close(fd);
+			is_open_ = true;
+			return true;
+		}
+
+		void close()
+		{
+			if(data_) {
+				munmap(const_cast<char*>(data_), size_);
+			}
+			is_open_ = false;
+			data_ = 0;
+			size_ = 0;
+			num_discarded_ = 0;
+		}
+
+		/** Releases the pages in front of 'p' when the file is read sequentially
+		 * Keeps the memory usage constant for files larger than the main memory.
+		 * Discarded pages are read again from the file if they are accessed.
+		 */
+		void discard(const char* p)
+		{
+			const std::size_t page_size = sysconf(_SC_PAGESIZE);
+			const std::size_t n = (p - data_) / page_size * page_size;
+			if(n > num_discarded_) {
+				madvise(const_cast<char*>(data_) + num_discarded_, n - num_discarded_, MADV_DONTNEED);
+				num_discarded_ = n;
+			}
+		}
+
+		bool is_open() const
+		{ return is_open_; }
+
+		const char* begin() const
+		{ return data_; }
+
+		const char* end() const
+		{ return data_ + size_; }
+
+		std::size_t size() const
+		{ return size_; }
+
+	private:
+		bool is_open_;
+		const char* data_;
+		std::size_t size_;
+		std::size_t num_discarded_;
+	};
+
+	/** Parses an unsigned decimal integer at 'p'
+	 * @return pointer behind the last digit or 0 if there is no digit or the value does not fit into T
+	 */
+	template<typename T>
+	inline const char* ParseUnsigned(const char* p, const char* end, T& value)
+	{
+		const char* first = p;
+		uint64_t v = 0;
+		while(p != end && static_cast<unsigned char>(*p - '0') < 10) {
+			v = 10*v + static_cast<uint64_t>(*p - '0');
+			++p;
+		}
+		// at most 19 digits can not overflow 64 bits
+		if(p == first || p - first > 19 || v > std::numeric_limits<T>::max()) {
+			return 0;
+		}
+		value = static_cast<T>(v);
+		return p;
+	}
+
+	/** Parses a right aligned unsigned decimal integer in the fixed width field [p, end[
+	 * The field may have leading spaces. The loop has no data dependent branches
+	 * so that the compiler can unroll and vectorize it for short fields.
+	 * @return false if the field has no digit, other characters or more than 19 digits
+	 */
+	template<typename T>
+	inline bool ParseFixedWidth(const char* p, const char* end, T& value)
+	{
+		uint64_t v = 0;
+		unsigned num_digits = 0;
+		bool valid = true;
+		for(; p != end; ++p) {
+			const unsigned d = static_cast<unsigned char>(*p - '0');
+			const bool is_digit = (d < 10);
+			// spaces are only allowed in front of the first digit
+			valid &= is_digit || (*p == ' ' && num_digits == 0);
+			v = is_digit ? 10*v + d : v;
+			num_digits += is_digit;
+		}
+		if(!valid || num_digits == 0 || num_digits > 19 || v > std::numeric_limits<T>::max()) {
+			return false;
+		}
+		value = static_cast<T>(v);
+		return true;
+	}
+
+	/** Parses an unsigned integer followed by 'separator'
+	 * @return pointer behind the separator or 0 on error
+	 */
+	template<typename T>
+	inline const char* ParseUnsignedField(const char* p, const char* end, T& value, char separator)
+	{
+		p = ParseUnsigned(p, end, value);
+		return (p == 0 || p == end || *p != separator) ? 0 : p + 1;
+	}
+
+	/** Pointer behind the next 'separator' or 0 if there is none */
+	inline const char* SkipField(const char* p, const char* end, char separator)
+	{
+		p = static_cast<const char*>(std::memchr(p, separator, end - p));
+		return (p == 0) ? 0 : p + 1;
+	}
+
+	/** Pointer behind the next line break or 'end' */
+	inline const char* NextLine(const char* p, const char* end)
+	{
+		const char* q = static_cast<const char*>(std::memchr(p, '\n', end - p));
+		return (q == 0) ? end : q + 1;
+	}
+
+	/** Calls 'parse_line(begin, end, event)' for each non-empty line of [begin, end[
+	 * Lines are passed without line break and '\r'. Events of lines for which
+	 * 'parse_line' returns false are not added.
+	 * @return number of malformed lines
+	 */
+	template<typename ParseLine>
+	std::size_t ParseLines(const char* begin, const char* end, ParseLine parse_line, std::vector<Event>& events)
+	{
+		std::size_t num_malformed = 0;
+		Event e;
+		while(begin != end) {
+			const char* next = NextLine(begin, end);
+			const char* line_end = next;
+			if(line_end != begin && line_end[-1] == '\n') {
+				--line_end;
+			}
+			if(line_end != begin && line_end[-1] == '\r') {
+				--line_end;
+			}
+			if(line_end != begin) {
+				if(parse_line(begin, line_end, e)) {
+					events.push_back(e);
+				}
+				else {
+					num_malformed++;
+				}
+			}
+			begin = next;
+		}
+		return num_malformed;
+	}
+
+	/** Minimum number of bytes parsed by one thread */
+	const std::size_t cMinBytesPerParserThread = 1<<20;
+
+	/** Parses a line based text on multiple threads, see ParseLines
+	 * The text is split into one chunk per thread at line boundaries. Chunks are
+	 * parsed in parallel and the events are concatenated in the order of the lines.
+	 * The previous content of 'events' is replaced.
+	 * @return number of malformed lines
+	 */
+	template<typename ParseLine>
+	std::size_t ParseLinesParallel(const char* begin, const char* end, ParseLine parse_line, std::vector<Event>& events)
+	{
+		const std::size_t size = end - begin;
+		std::size_t num_threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+		num_threads = std::max<std::size_t>(1, std::min(num_threads, size / cMinBytesPerParserThread));
+		events.clear();
+		if(num_threads == 1) {
+			return ParseLines(begin, end, parse_line, events);
+		}
+		// chunk boundaries at line starts
+		std::vector<const char*> bounds(num_threads + 1);
+		bounds[0] = begin;
+		for(std::size_t i=1; i<num_threads; i++) {
+			const char* p = begin + size*i/num_threads;
+			bounds[i] = (p <= bounds[i-1]) ? bounds[i-1] : NextLine(p - 1, end);
+		}
+		bounds[num_threads] = end;
+		// parse chunks, the calling thread takes the first one
+		std::vector<std::vector<Event>> parts(num_threads);
+		std::vector<std::size_t> malformed(num_threads, 0);
+		auto parse_chunk = [&](std::size_t i) {
+			// guess the number of events from the chunk size
+			parts[i].reserve((bounds[i+1] - bounds[i]) / 16);
+			malformed[i] = ParseLines(bounds[i], bounds[i+1], parse_line, parts[i]);
+		};
+		std::vector<std::thread> threads;
+		for(std::size_t i=1; i<num_threads; i++) {
+			threads.emplace_back(parse_chunk, i);
+		}
+		parse_chunk(0);
+		for(std::thread& t : threads) {
+			t.join();
+		}
+		// concatenate
+		std::size_t total = 0;
+		std::size_t num_malformed = 0;
+		for(std::size_t i=0; i<num_threads; i++) {
+			total += parts[i].size();
+			num_malformed += malformed[i];
+		}
+		events.reserve(total);
+		for(std::size_t i=0; i<num_threads; i++) {
+			events.insert(events.end(), parts[i].begin(), parts[i].end());
+			std::vector<Event>().swap(parts[i]);
+		}
+		return num_malformed;
+	}
+
+}
+
+#endif
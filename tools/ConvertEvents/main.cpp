@@ -11,20 +11,26 @@
 
 int main(int argc, char** argv)
 {
-	std::string p_in;
+	std::vector<std::string> p_in;
+	bool p_merge = false;
 	std::string p_in_format = "natural";
 	std::string p_out;
 	std::string p_out_format = "tsv";
+	std::string p_compression = "none";
+	uint64_t p_wrap = Edvs::cDeviceTimestampWrap;
 
 	namespace po = boost::program_options;
 	// Declare the supported options.
 	po::options_description desc("Allowed options");
 	desc.add_options()
 		("help", "produce help message")
-		("in", po::value(&p_in), "filename of input event file (text format)")
+		("in", po::value(&p_in), "filename of input event file, can be given multiple times with --merge")
+		("merge", po::bool_switch(&p_merge), "load all input files concurrently and merge their events by timestamp")
 		("in-format", po::value(&p_in_format)->default_value(p_in_format), "format of input file")
 		("out", po::value(&p_out), "filename of output event file (binary format)")
 		("out-format", po::value(&p_out_format)->default_value(p_out_format), "format of output file")
+		("compression", po::value(&p_compression)->default_value(p_compression), "compression of binary output files: none, zlib or zstd")
+		("wrap", po::value(&p_wrap)->default_value(p_wrap), "period after which device timestamps in jc and old files wrap to 0, e.g. 16777216 for 24 bit timestamps")
 	;
 
 	po::variables_map vm;
@@ -35,53 +41,74 @@ int main(int argc, char** argv)
 		std::cout << desc << std::endl;
 		std::cout << "Supported file formats:" << std::endl;
 		std::cout << "\tnatural: binary default file format" << std::endl;
+		std::cout << "\tcompact: binary default file format with delta encoded events (read as natural)" << std::endl;
 		std::cout << "\tcsv: text comma separated values" << std::endl;
 		std::cout << "\ttsv: text tab separated values" << std::endl;
-		std::cout << "\tjc: JC file format" << std::endl;
-		std::cout << "\told: A deprecated binary file format" << std::endl;
+		std::cout << "\tjc: JC file format (input only)" << std::endl;
+		std::cout << "\tebslam3: EB-SLAM-3D file format (input only)" << std::endl;
+		std::cout << "\told: A deprecated binary file format (input only)" << std::endl;
 		return 1;
 	}
 
-	std::vector<Edvs::Event> events;
-
-	std::cout << "Loading events from file '" << p_in << "'..." << std::flush;
-	if(p_in_format == "natural") {
-		events = Edvs::LoadEvents(p_in);
-	}
-	else if(p_in_format == "csv") {
-		events = Edvs::LoadEventsTable(p_in, ',');
+	uint32_t compression = EDVS_COMPRESSION_NONE;
+	if(p_compression == "zlib") {
+		compression = EDVS_COMPRESSION_ZLIB;
 	}
-	else if(p_in_format == "tsv") {
-		events = Edvs::LoadEventsTable(p_in, '\t');
+	else if(p_compression == "zstd") {
+		compression = EDVS_COMPRESSION_ZSTD;
 	}
-	else if(p_in_format == "jc") {
-		events = Edvs::LoadEventsJC(p_in, true);
-	}
-	else if(p_in_format == "ebslam3") {
-		events = Edvs::LoadEventsEBSLAM3(p_in);
+	else if(p_compression != "none") {
+		std::cerr << "Unsupported compression!" << std::endl;
+		return 1;
 	}
-	else if(p_in_format == "old") {
-		events = Edvs::LoadEventsOld(p_in, true);
+	if(!edvs_file_compression_supported(compression)) {
+		std::cerr << "Compression '" << p_compression << "' is not supported by this build of libEdvs!" << std::endl;
+		return 1;
 	}
-	else {
-		std::cerr << "Unsupported input file format!" << std::endl;
+
+	if(p_in.size() > 1 && !p_merge) {
+		std::cerr << "Multiple input files need --merge!" << std::endl;
+		return 1;
 	}
-	std::cout << " done (" << events.size() << " events)." << std::endl;
 
-	std::cout << "Saving events to file '" << p_out << "'..." << std::flush;
-	if(p_out_format == "natural") {
-		Edvs::SaveEvents(p_out, events);
+	if(p_merge) {
+		// merging needs all events in memory
+		std::cout << "Merging events from " << p_in.size() << " files..." << std::flush;
+		std::vector<Edvs::Event> events;
+		if(!Edvs::LoadEventsMerged(p_in, p_in_format, events, p_wrap)) {
+			return 1;
+		}
+		std::cout << " done (" << events.size() << " events)." << std::endl;
+		std::unique_ptr<Edvs::EventWriter> writer = Edvs::OpenEventWriter(p_out, p_out_format, compression);
+		if(!writer) {
+			return 1;
+		}
+		std::cout << "Writing events to file '" << p_out << "'..." << std::flush;
+		if(!writer->write_batch(events.data(), events.size()) || !writer->close()) {
+			std::cerr << "Error writing file '" << p_out << "'!" << std::endl;
+			return 1;
+		}
+		std::cout << " done." << std::endl;
+		return 1;
 	}
-	else if(p_out_format == "csv") {
-		Edvs::SaveEventsTable(p_out, events, ',');
+
+	std::unique_ptr<Edvs::EventReader> reader = Edvs::OpenEventReader(p_in.front(), p_in_format, p_wrap);
+	if(!reader) {
+		return 1;
 	}
-	else if(p_out_format == "tsv") {
-		Edvs::SaveEventsTable(p_out, events, '\t');
+	std::unique_ptr<Edvs::EventWriter> writer = Edvs::OpenEventWriter(p_out, p_out_format, compression);
+	if(!writer) {
+		return 1;
 	}
-	else {
-		std::cerr << "Unsupported output file format!" << std::endl;
+
+	// events are converted batch by batch, so files larger than the main memory work
+	std::cout << "Converting events from file '" << p_in.front() << "' to file '" << p_out << "'..." << std::flush;
+	uint64_t num_events;
+	if(!Edvs::CopyEvents(*reader, *writer, num_events)) {
+		std::cerr << "Error writing file '" << p_out << "'!" << std::endl;
+		return 1;
 	}
-	std::cout << " done." << std::endl;
+	std::cout << " done (" << num_events << " events)." << std::endl;
 
 	return 1;
 }
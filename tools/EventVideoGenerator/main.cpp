@@ -1,14 +1,102 @@
+#include <Edvs/EventFileView.hpp>
 #include <Edvs/EventIO.hpp>
+#include <Edvs/EventBatchSoA.hpp>
 #include "lodepng.h"
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
 #include <Eigen/Dense>
 #include <vector>
+#include <deque>
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <cmath>
 
+/** Renders and saves frames on worker threads
+ * At most 'max_in_flight' frames are queued or in work, so the memory usage
+ * is bounded. Each frame job writes its own file, which is named in frame
+ * order before the job is pushed, so frames may finish in any order.
+ */
+class FramePipeline
+{
+public:
+	/** With 'num_threads' <= 1 jobs run directly on the calling thread */
+	FramePipeline(unsigned num_threads, std::size_t max_in_flight)
+	: max_in_flight_(std::max<std::size_t>(max_in_flight, 1)), num_in_flight_(0), is_finished_(false)
+	{
+		for(unsigned i=0; num_threads > 1 && i<num_threads; i++) {
+			threads_.emplace_back([this]() { run(); });
+		}
+	}
+
+	~FramePipeline()
+	{
+		finish();
+	}
+
+	/** Adds a frame job, blocks while too many frames are in flight */
+	void push(const std::function<void()>& job)
+	{
+		if(threads_.empty()) {
+			job();
+			return;
+		}
+		std::unique_lock<std::mutex> lock(mtx_);
+		cv_.wait(lock, [this]() { return num_in_flight_ < max_in_flight_; });
+		jobs_.push_back(job);
+		num_in_flight_++;
+		cv_.notify_all();
+	}
+
+	/** Waits until all frames are done and stops the workers */
+	void finish()
+	{
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			cv_.wait(lock, [this]() { return num_in_flight_ == 0; });
+			is_finished_ = true;
+			cv_.notify_all();
+		}
+		for(std::thread& t : threads_) {
+			t.join();
+		}
+		threads_.clear();
+	}
+
+private:
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mtx_);
+		while(true) {
+			cv_.wait(lock, [this]() { return !jobs_.empty() || is_finished_; });
+			if(jobs_.empty()) {
+				break;
+			}
+			std::function<void()> job;
+			job.swap(jobs_.front());
+			jobs_.pop_front();
+			lock.unlock();
+			job();
+			lock.lock();
+			num_in_flight_--;
+			cv_.notify_all();
+		}
+	}
+
+	std::size_t max_in_flight_;
+	std::size_t num_in_flight_;
+	bool is_finished_;
+	std::deque<std::function<void()>> jobs_;
+	std::vector<std::thread> threads_;
+	std::mutex mtx_;
+	std::condition_variable cv_;
+};
+
 struct mat8
 {
 	std::vector<unsigned char> data;
@@ -46,15 +134,45 @@ unsigned int clip_retina_coord(float u)
 				static_cast<int>(std::floor(0.5f + u)))));
 }
 
-void create_video(const std::vector<Edvs::Event>& events, uint64_t dt, uint64_t decay, boost::format fmt_fn, bool skip_empty, uint8_t id=0)
+/** Paints the events [begin, end[ of a batch with a color depending on age and parity */
+void paint_events(const Edvs::EventBatchSoA& batch, std::size_t begin, std::size_t end, uint64_t frametime, uint64_t decay, uint8_t id, std::vector<unsigned char>& colors, mat8& retina)
+{
+	const uint64_t* ts = batch.t.data();
+	const uint8_t* ps = batch.parity.data();
+	// colors are computed in a loop which can be vectorized, only painting is sequential
+	colors.resize(end - begin);
+	unsigned char* cs = colors.data();
+	const float fdecay = static_cast<float>(decay);
+	for(std::size_t i=begin; i<end; i++) {
+		unsigned char d = static_cast<unsigned>(127.0f*static_cast<float>(frametime - ts[i])/fdecay);
+		cs[i - begin] = (ps[i] ? 255-d : d);
+	}
+	const uint16_t* xs = batch.x.data();
+	const uint16_t* ys = batch.y.data();
+	const uint8_t* ids = batch.id.data();
+	for(std::size_t i=begin; i<end; i++) {
+		if(ids[i] != id) {
+			continue;
+		}
+		unsigned int x = std::min<unsigned int>(xs[i], RETINA_SIZE-1);
+		unsigned int y = std::min<unsigned int>(ys[i], RETINA_SIZE-1);
+		retina(y, x) = cs[i - begin];
+	}
+}
+
+/** Creates frames for events of an EventFileView or a std::vector<Edvs::Event> */
+template<typename Events>
+void create_video(const Events& events, uint64_t dt, uint64_t decay, boost::format fmt_fn, bool skip_empty, FramePipeline& pipeline, uint8_t id=0)
 {
-	mat8 retina(RETINA_SIZE, RETINA_SIZE);
 	uint64_t frametime = events.front().t + dt;
 	auto it_begin = events.begin();
+	// consecutive frames overlap, so events are transposed once for many frames
+	// frames in flight keep their block alive when the next block is transposed
+	const std::size_t block_size = 1 << 18;
+	std::shared_ptr<Edvs::EventBatchSoA> batch(new Edvs::EventBatchSoA());
+	std::size_t batch_offset = 0;
 	unsigned frame_save_id = 0;
 	for(unsigned frame=0; it_begin!=events.end(); frame++, frametime+=dt) {
-		// prepare frame
-		std::fill(retina.data.begin(), retina.data.end(), 128);
 		// find first and last event
 		uint64_t t_begin = (frametime <= decay) ? 0 : frametime - decay;
 		auto time_cmp = [](const Edvs::Event& e, uint64_t t) { return e.t < t; };
@@ -65,19 +183,26 @@ void create_video(const std::vector<Edvs::Event>& events, uint64_t dt, uint64_t
 			continue;
 		}
 		// paint events
-		for(auto it=it_begin; it!=it_end; ++it) {
-			const Edvs::Event& event = *it;
-			if(event.id != id) {
-				continue;
-			}
-			unsigned int x = clip_retina_coord(event.x);
-			unsigned int y = clip_retina_coord(event.y);
-			unsigned char d = static_cast<unsigned>(127.0f*static_cast<float>(frametime - event.t)/static_cast<float>(decay));
-			unsigned char c = (event.parity ? 255-d : d);
-			retina(y, x) = c;
+		const std::size_t i_begin = it_begin - events.begin();
+		const std::size_t i_end = it_end - events.begin();
+		if(i_begin < batch_offset || i_end > batch_offset + batch->size()) {
+			batch_offset = i_begin;
+			batch.reset(new Edvs::EventBatchSoA());
+			batch->assign(events.data() + i_begin,
+				std::min(std::max(block_size, i_end - i_begin), events.size() - i_begin));
 		}
 		std::cout << "Frame " << frame << ": time=" << frametime << ", #events=" << std::distance(it_begin, it_end) << std::endl;
-		save_png((fmt_fn % frame_save_id).str(), retina);
+		const std::shared_ptr<const Edvs::EventBatchSoA> frame_batch = batch;
+		const std::size_t begin = i_begin - batch_offset;
+		const std::size_t end = i_end - batch_offset;
+		const std::string fn = (fmt_fn % frame_save_id).str();
+		pipeline.push([frame_batch, begin, end, frametime, decay, id, fn]() {
+			mat8 retina(RETINA_SIZE, RETINA_SIZE);
+			std::fill(retina.data.begin(), retina.data.end(), 128);
+			std::vector<unsigned char> colors;
+			paint_events(*frame_batch, begin, end, frametime, decay, id, colors, retina);
+			save_png(fn, retina);
+		});
 		frame_save_id ++;
 	}
 }
@@ -196,15 +321,28 @@ inline
 uint64_t DeltaT(uint64_t a, uint64_t b)
 { return std::max<int64_t>(0, static_cast<int64_t>(b) - static_cast<int64_t>(a)); }
 
-void create_video(const std::vector<ColoredEvent>& events, uint64_t dt, uint64_t decay, boost::format fmt_fn, bool skip_empty)
+void paint_colored_events(std::vector<ColoredEvent>::const_iterator it_begin, std::vector<ColoredEvent>::const_iterator it_end, uint64_t frametime, uint64_t decay, MatRGB& retina)
+{
+	for(auto it=it_begin; it!=it_end; ++it) {
+		const auto& event = *it;
+		if(event.id != 0) continue;
+		unsigned int x = clip_retina_coord(event.x);
+		unsigned int y = clip_retina_coord(event.y);
+		float p = std::min(1.0f,static_cast<float>(frametime - event.t)/static_cast<float>(decay));
+		unsigned char cr, cg, cb;
+		Color(Decay(ColorizeDisparity(event.disparity),p), cr, cg, cb);
+		retina(y, x, 0) = cr;
+		retina(y, x, 1) = cg;
+		retina(y, x, 2) = cb;
+	}
+}
+
+void create_video(const std::vector<ColoredEvent>& events, uint64_t dt, uint64_t decay, boost::format fmt_fn, bool skip_empty, FramePipeline& pipeline)
 {
-	MatRGB retina(RETINA_SIZE, RETINA_SIZE);
 	uint64_t frametime = events.front().t + dt;
 	auto it_begin = events.begin();
 	unsigned frame_save_id = 0;
 	for(unsigned frame=0; it_begin!=events.end(); frame++, frametime+=dt) {
-		// prepare frame
-		std::fill(retina.data.begin(), retina.data.end(), 255);
 		// find first and last event
 		uint64_t t_begin = (frametime <= decay) ? 0 : frametime - decay;
 		auto time_cmp = [](const ColoredEvent& e, uint64_t t) { return e.t < t; };
@@ -214,21 +352,15 @@ void create_video(const std::vector<ColoredEvent>& events, uint64_t dt, uint64_t
 		if(skip_empty && it_begin == it_end) {
 			continue;
 		}
-		// paint events
-		for(auto it=it_begin; it!=it_end; ++it) {
-			const auto& event = *it;
-			if(event.id != 0) continue;
-			unsigned int x = clip_retina_coord(event.x);
-			unsigned int y = clip_retina_coord(event.y);
-			float p = std::min(1.0f,static_cast<float>(frametime - event.t)/static_cast<float>(decay));
-			unsigned char cr, cg, cb;
-			Color(Decay(ColorizeDisparity(event.disparity),p), cr, cg, cb);
-			retina(y, x, 0) = cr;
-			retina(y, x, 1) = cg;
-			retina(y, x, 2) = cb;
-		}
+		// paint events, 'events' is not modified while frames are in flight
 		std::cout << "Frame " << frame << ": time=" << frametime << ", #events=" << std::distance(it_begin, it_end) << std::endl;
-		save_png((fmt_fn % frame_save_id).str(), retina);
+		const std::string fn = (fmt_fn % frame_save_id).str();
+		pipeline.push([it_begin, it_end, frametime, decay, fn]() {
+			MatRGB retina(RETINA_SIZE, RETINA_SIZE);
+			std::fill(retina.data.begin(), retina.data.end(), 255);
+			paint_colored_events(it_begin, it_end, frametime, decay, retina);
+			save_png(fn, retina);
+		});
 		frame_save_id ++;
 	}
 }
@@ -242,6 +374,7 @@ int main(int argc, char** argv)
 	bool p_skip_empty = false;
 	unsigned p_id = 0;
 	bool p_colored = false;
+	unsigned p_threads = 0;
 
 	namespace po = boost::program_options;
 	// Declare the supported options.
@@ -255,6 +388,7 @@ int main(int argc, char** argv)
 		("colored", po::value(&p_colored)->default_value(p_colored), "set to true to parse events with color")
 		("noempty", po::value(&p_skip_empty), "whether to skip empty frames")
 		("id", po::value(&p_id)->default_value(p_id), "sensor id")
+		("threads", po::value(&p_threads)->default_value(p_threads), "number of threads rendering and encoding frames, 0 for one per core")
 	;
 
 	po::variables_map vm;
@@ -266,21 +400,54 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
+	if(p_threads == 0) {
+		p_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	// lodepng computes its CRC table on first use, so it is done here before the workers start
+	lodepng_crc32(0, 0);
+	// frames are rendered and PNG encoded in parallel, which dominates the run time
+	FramePipeline pipeline(p_threads, 2*p_threads);
+
 	if(p_colored) {
 		// read events
 		auto events = LoadColoredEvents(p_fn);
 		std::cout << "Read " << events.size() << " events" << std::endl;
 		// create video
 		boost::format fmt_fn(p_dir + "/%05d.png");
-		create_video(events, p_dt, p_decay, fmt_fn, p_skip_empty); // TODO p_id
+		create_video(events, p_dt, p_decay, fmt_fn, p_skip_empty, pipeline); // TODO p_id
+		pipeline.finish();
 	}
 	else {
-		// read events
-		auto events = Edvs::LoadEvents(p_fn);
-		std::cout << "Read " << events.size() << " events" << std::endl;
+		Edvs::EventFileHeader header;
+		if(!Edvs::LoadEventFileHeader(p_fn, header)) {
+			return 1;
+		}
+		// map events (only the frames currently painted need to be in memory)
+		// delta encoded and compressed files can not be mapped and are loaded
+		const bool is_mappable = Edvs::IsMappable(header);
+		Edvs::EventFileView mapped_events;
+		std::vector<Edvs::Event> loaded_events;
+		if(is_mappable) {
+			mapped_events.open(p_fn);
+		}
+		else {
+			loaded_events = Edvs::LoadEvents(p_fn);
+		}
+		const std::size_t num_events = is_mappable ? mapped_events.size() : loaded_events.size();
+		if(num_events == 0) {
+			std::cerr << "No events in file '" << p_fn << "'" << std::endl;
+			return 0;
+		}
+		std::cout << "Read " << num_events << " events" << std::endl;
 		// create video
 		boost::format fmt_fn(p_dir + "/%05d.png");
-		create_video(events, p_dt, p_decay, fmt_fn, p_skip_empty, p_id);
+		if(is_mappable) {
+			create_video(mapped_events, p_dt, p_decay, fmt_fn, p_skip_empty, pipeline, p_id);
+		}
+		else {
+			create_video(loaded_events, p_dt, p_decay, fmt_fn, p_skip_empty, pipeline, p_id);
+		}
+		pipeline.finish();
 	}
 
 	// hit for ffmpeg
@@ -0,0 +1,158 @@
+/*
+ * main.cpp
+ *
+ * Records events from one or more event streams to event files without a GUI.
+ */
+
+#include <Edvs/EventStream.hpp>
+#include <Edvs/EventRecorder.hpp>
+#include <boost/program_options.hpp>
+#include <signal.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+volatile sig_atomic_t is_interrupted = 0;
+
+void on_interrupt(int)
+{
+	is_interrupted = 1;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> p_uris;
+	std::string p_out;
+	std::string p_format = "natural";
+	std::string p_compression = "none";
+	double p_duration = 0.0;
+	double p_split_size = 0.0;
+	double p_split_time = 0.0;
+	int p_cpu = -1;
+	bool p_direct_io = false;
+	double p_stats = 1.0;
+	std::size_t p_queue = 1<<22;
+
+	namespace po = boost::program_options;
+	// Declare the supported options.
+	po::options_description desc("Allowed options");
+	desc.add_options()
+		("help", "produce help message")
+		("uri", po::value(&p_uris)->multitoken(), "URIs of the event streams (see README), multiple streams are merged")
+		("out", po::value(&p_out), "filename of output event file")
+		("format", po::value(&p_format)->default_value(p_format), "format of output file: natural or compact")
+		("compression", po::value(&p_compression)->default_value(p_compression), "compression of output file: none, zlib or zstd")
+		("duration", po::value(&p_duration)->default_value(p_duration), "recording time in seconds, 0 to record until Ctrl+C or end of stream")
+		("split-size", po::value(&p_split_size)->default_value(p_split_size), "start a new file after this many MB, 0 for a single file")
+		("split-time", po::value(&p_split_time)->default_value(p_split_time), "start a new file after this many seconds of events, 0 for a single file")
+		("cpu", po::value(&p_cpu)->default_value(p_cpu), "pin capture threads to this CPU, -1 for no pinning")
+		("direct-io", po::bool_switch(&p_direct_io), "write with O_DIRECT, bypassing the page cache")
+		("stats", po::value(&p_stats)->default_value(p_stats), "interval in seconds for printing statistics, 0 for none")
+		("queue", po::value(&p_queue)->default_value(p_queue), "number of events which can be queued for writing")
+	;
+
+	po::variables_map vm;
+	po::store(po::parse_command_line(argc, argv, desc), vm);
+	po::notify(vm);
+
+	if(vm.count("help") || p_uris.empty() || p_out.empty()) {
+		std::cout << desc << std::endl;
+		return 1;
+	}
+
+	Edvs::EventRecorderParameters rec_params;
+	if(p_format == "compact") {
+		rec_params.header.encoding = EDVS_ENCODING_DELTA;
+	}
+	else if(p_format != "natural") {
+		std::cerr << "Unsupported output format!" << std::endl;
+		return 1;
+	}
+	if(p_compression == "zlib") {
+		rec_params.header.compression = EDVS_COMPRESSION_ZLIB;
+	}
+	else if(p_compression == "zstd") {
+		rec_params.header.compression = EDVS_COMPRESSION_ZSTD;
+	}
+	else if(p_compression != "none") {
+		std::cerr << "Unsupported compression!" << std::endl;
+		return 1;
+	}
+	if(!edvs_file_compression_supported(rec_params.header.compression)) {
+		std::cerr << "Compression '" << p_compression << "' is not supported by this build of libEdvs!" << std::endl;
+		return 1;
+	}
+	rec_params.queue_capacity = p_queue;
+	rec_params.direct_io = p_direct_io;
+	rec_params.max_file_size = static_cast<uint64_t>(p_split_size*1024.0*1024.0);
+	rec_params.max_file_duration = static_cast<uint64_t>(p_split_time*1000000.0);
+
+	// count dropped events instead of stalling the device
+	Edvs::EventStreamParameters stream_params;
+	stream_params.overflow_policy = Edvs::OverflowPolicy::DropNewest;
+	stream_params.capture_cpu = p_cpu;
+
+	struct sigaction sa;
+	sa.sa_handler = on_interrupt;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	Edvs::EventRecorder recorder(p_out, rec_params);
+	if(!recorder.is_open()) {
+		return 1;
+	}
+
+	std::shared_ptr<Edvs::IEventStream> stream = (p_uris.size() == 1)
+		? Edvs::OpenEventStream(p_uris.front(), stream_params)
+		: Edvs::OpenEventStream(p_uris, stream_params);
+	if(!stream->is_open()) {
+		std::cerr << "Could not open event stream!" << std::endl;
+		return 1;
+	}
+
+	std::cout << "Recording to '" << p_out << "' (press Ctrl+C to stop)" << std::endl;
+
+	typedef std::chrono::steady_clock clock;
+	const clock::time_point start = clock::now();
+	clock::time_point last_stats = start;
+	uint64_t last_num_written = 0;
+	std::vector<Edvs::Event> events;
+	while(!is_interrupted && !stream->eos()) {
+		// blocks until events arrive, so no CPU is used while the sensors are quiet
+		stream->read_wait(events, 1, std::chrono::milliseconds(100));
+		recorder.record(events);
+		const clock::time_point now = clock::now();
+		const double elapsed = std::chrono::duration<double>(now - start).count();
+		if(p_stats > 0.0 && std::chrono::duration<double>(now - last_stats).count() >= p_stats) {
+			const uint64_t num_written = recorder.num_written();
+			const double dt = std::chrono::duration<double>(now - last_stats).count();
+			std::cout << "Time " << elapsed << " s"
+				<< ", " << static_cast<uint64_t>(static_cast<double>(num_written - last_num_written)/dt) << " events/s"
+				<< ", written " << num_written
+				<< ", dropped " << stream->num_dropped() + recorder.num_dropped()
+				<< ", files " << recorder.num_files()
+				<< std::endl;
+			last_stats = now;
+			last_num_written = num_written;
+		}
+		if(p_duration > 0.0 && elapsed >= p_duration) {
+			break;
+		}
+	}
+
+	const uint64_t num_stream_dropped = stream->num_dropped();
+	stream.reset();
+	recorder.stop();
+
+	const double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+	std::cout << "Recorded " << recorder.num_written() << " events in " << elapsed << " s"
+		<< " to " << recorder.num_files() << " file(s)"
+		<< ", dropped " << num_stream_dropped << " events in the stream"
+		<< " and " << recorder.num_dropped() << " in the recorder" << std::endl;
+	for(std::size_t k=0; k<recorder.num_files(); k++) {
+		std::cout << "\t" << recorder.file_name(k) << std::endl;
+	}
+	return recorder.has_error() ? 1 : 0;
+}
@@ -1,5 +1,4 @@
 #include "WdgtEdvsVisual.h"
-#include <Edvs/EventIO.hpp>
 #include <QtGui/QFileDialog>
 #include <iostream>
 
@@ -8,6 +7,7 @@ const unsigned int RetinaSize = 128;
 const int cDecay = 24;
 const int cDisplaySize = 4*128;
 const int cUpdateInterval = 0;
+const int cUpdateTimeout = 10;
 const int cDisplayInterval = 20;
 
 // blue/yellow color scheme
@@ -27,7 +27,6 @@ EdvsVisual::EdvsVisual(const std::shared_ptr<Edvs::IEventStream>& stream, QWidge
 	ui.setupUi(this);
 
 	connect(ui.pushButtonRecord, SIGNAL(clicked()), this, SLOT(OnButton()));
-	is_recording_ = false;
 
 	connect(&timer_update_, SIGNAL(timeout()), this, SLOT(Update()));
 	timer_update_.setInterval(cUpdateInterval);
@@ -44,31 +43,40 @@ EdvsVisual::~EdvsVisual()
 void EdvsVisual::OnButton()
 {
 	if(ui.pushButtonRecord->isChecked()) {
+		// get filename, events are written while recording
+		QString fn = QFileDialog::getSaveFileName(this, "Select file to save recording");
+		if(fn != "") {
+			recorder_.reset(new Edvs::EventRecorder(fn.toStdString()));
+		}
+		if(!recorder_ || !recorder_->is_open()) {
+			recorder_.reset();
+			ui.pushButtonRecord->setChecked(false);
+			return;
+		}
 		// start recording
 		ui.pushButtonRecord->setText("Recording... (press to stop)");
-		is_recording_ = true;
 	}
-	else {
+	else if(recorder_) {
 		// stop recording
 		ui.pushButtonRecord->setText("Start recording");
-		is_recording_ = false;
-		// get filename
-		QString fn = QFileDialog::getSaveFileName(this, "Select file to save recording");
-		if(fn != "") {
-			Edvs::SaveEvents(fn.toStdString(), events_recorded_);
-			std::cout << "Saved " << events_recorded_.size() << " events to file '" << fn.toStdString() << "'" << std::endl;
+		recorder_->stop();
+		std::cout << "Saved " << recorder_->num_written() << " events to file '" << recorder_->file_name(0) << "'";
+		if(recorder_->num_dropped() > 0) {
+			std::cout << " (dropped " << recorder_->num_dropped() << " events)";
 		}
-		events_recorded_.clear();
+		std::cout << std::endl;
+		recorder_.reset();
 	}
 }
 
 void EdvsVisual::Update()
 {
-	// read events
-	auto events = edvs_event_stream_->read();
+	// read events (sleeps a bit if there are none to keep the GUI responsive)
+	std::vector<Edvs::Event>& events = events_;
+	edvs_event_stream_->read_wait(events, 1, std::chrono::milliseconds(cUpdateTimeout));
 
-	if(is_recording_) {
-		events_recorded_.insert(events_recorded_.end(), events.begin(), events.end());
+	if(recorder_) {
+		recorder_->record(events);
 	}
 
 	// print time information
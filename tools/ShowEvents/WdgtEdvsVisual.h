@@ -5,7 +5,9 @@
 #include <QtCore/QTimer>
 #include "ui_WdgtEdvsVisual.h"
 #include <Edvs/EventStream.hpp>
+#include <Edvs/EventRecorder.hpp>
 #include <vector>
+#include <memory>
 
 class EdvsVisual : public QWidget
 {
@@ -35,8 +37,9 @@ private:
 
 	std::vector<Item> items_;
 
-	bool is_recording_;
-	std::vector<Edvs::Event> events_recorded_;
+	std::vector<Edvs::Event> events_;
+
+	std::unique_ptr<Edvs::EventRecorder> recorder_;
 
 private:
     Ui::EdvsVisualClass ui;